@@ -18,12 +18,17 @@
 #include <linux/lcm.h>
 #include <linux/i2c.h>
 #include <linux/gpio.h>
+#include <linux/gpio/consumer.h>
 #include <linux/of_gpio.h>
 #include <linux/interrupt.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
 #include <linux/delay.h>
 #include <linux/pinctrl/consumer.h>
+#include <linux/workqueue.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/atomic.h>
 #include <video/of_display_timing.h>
 
 #include "lcdc_drv.h"
@@ -48,6 +53,7 @@
 #define LCD_DMA_BURST_4			0x2
 #define LCD_DMA_BURST_8			0x3
 #define LCD_DMA_BURST_16		0x4
+#define LCD_DMA_FIFO_TH_MAX		0x6
 #define LCD_V1_END_OF_FRAME_INT_ENA	BIT(2)
 #define LCD_V2_END_OF_FRAME0_INT_ENA	BIT(8)
 #define LCD_V2_END_OF_FRAME1_INT_ENA	BIT(9)
@@ -116,14 +122,32 @@
 #define  LCD_CLK_RESET_REG			0x70
 #define  LCD_CLK_MAIN_RESET			BIT(3)
 
-#define LCD_NUM_BUFFERS	2
+/* 9 frames at 8bpp, the 8 bit planes of pgraphy --grey plus the one write() fills */
+#define LCD_NUM_BUFFERS	3
 
 #define WSI_TIMEOUT	50
 #define PALETTE_SIZE	256
+#define PALETTE_BYTES	(PALETTE_SIZE * 2)
+
+/* Palette entry 0 carries the bpp of the frame buffer */
+#define PALETTE_BPP_8		0x3000
+#define PALETTE_BPP_12_24	0x4000
+
+/* Channels the 8 bit intensity is mapped onto in mono mode */
+#define MONO_CHANNEL_R		BIT(0)
+#define MONO_CHANNEL_G		BIT(1)
+#define MONO_CHANNEL_B		BIT(2)
+#define MONO_CHANNEL_ALL	(MONO_CHANNEL_R | MONO_CHANNEL_G | MONO_CHANNEL_B)
 
 #define	CLK_MIN_DIV	2
 #define	CLK_MAX_DIV	255
 
+/* DMA auto-tune: underflows per period that trigger a step up, and how many
+ * clean periods a configuration has to survive before it is recorded */
+#define DMA_TUNE_PERIOD_MS	1000
+#define DMA_TUNE_UNDERFLOW_TH	4
+#define DMA_TUNE_STABLE_PERIODS	10
+
 #define DEBUG 1
 #ifdef DEBUG
 #define DEBUG_PRINTF(fmt, ...) pr_info("[DEBUG] " fmt, ##__VA_ARGS__)
@@ -131,33 +155,110 @@
 #define DEBUG_PRINTF(fmt, ...) // Expands to nothing in non-debug builds
 #endif
 
-static DECLARE_WAIT_QUEUE_HEAD(gpio_event_wait);
-static int gpio_event_occurred = 0;
-static int irq_number;
+#define LCDC_MAX_INSTANCES	4
+
+/* One DLPC projector; registered by dlp_probe(), claimed by one fb_probe() */
+struct dlpc_dev {
+    struct i2c_client   *client;
+    struct gpio_desc    *proj_rdy;
+    struct gpio_desc    *proj_en;
+    int                 irq;
+    wait_queue_head_t   event_wait;
+    int                 event_occurred;
+    bool                claimed;
+    struct device       *owner;     // the claiming fb device
+    struct list_head    node;
+};
+
+static LIST_HEAD(dlpc_list);
+static DEFINE_MUTEX(dlpc_list_lock);
+
+static struct dlpc_dev *dlpc_claim(struct platform_device *dev)
+{
+    struct device_node *np = of_parse_phandle(dev->dev.of_node, "ti,dlpc", 0);
+    struct dlpc_dev *dlpc, *found = NULL;
+
+    mutex_lock(&dlpc_list_lock);
 
-static struct gpio_desc *proj_rdy, *proj_en;
+    // Without a "ti,dlpc" phandle take the first free projector
+    list_for_each_entry(dlpc, &dlpc_list, node) {
+        if (dlpc->claimed) {
+            continue;
+        }
+
+        if (np && dlpc->client->dev.of_node != np) {
+            continue;
+        }
+
+        dlpc->claimed = true;
+        dlpc->owner = &dev->dev;
+        found = dlpc;
+        break;
+    }
+
+    mutex_unlock(&dlpc_list_lock);
 
-static struct i2c_client *i2c_client;
-volatile bool wait_for_i2c = true;
+    of_node_put(np);
+
+    return found;
+}
+
+static void dlpc_release(struct dlpc_dev *dlpc)
+{
+    mutex_lock(&dlpc_list_lock);
+    dlpc->claimed = false;
+    dlpc->owner = NULL;
+    mutex_unlock(&dlpc_list_lock);
+}
 
 static inline void uint32_to_bytes(uint32_t in, uint8_t *out)
 {
-    out[0] = in & 0xFF000000;
-    out[1] = in & 0x00FF0000;
-    out[2] = in & 0x0000FF00;
-    out[3] = in & 0x000000FF;
+    out[0] = (in >> 24) & 0xFF;
+    out[1] = (in >> 16) & 0xFF;
+    out[2] = (in >> 8) & 0xFF;
+    out[3] = in & 0xFF;
+}
+
+static inline uint32_t bytes_to_uint32(const uint8_t *in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) |
+        ((uint32_t)in[2] << 8) | in[3];
 }
 
+#define DLPC_REG_SIZE       4
+#define DLPC_REG_DEV_ID     0x03
+#define DLPC_DEV_ID         0x8A
+#define DLPC_REG_CURTAIN    0xA6
+
+struct dlpc_reg {
+    uint8_t addr;
+    uint32_t val;
+    /* Read back by dlpc_is_configured() to detect an already set up DLPC */
+    bool verify;
+};
+
+/* Written in order after the device ID check, in a single I2C transfer */
+static const struct dlpc_reg dlpc_init_table[] = {
+    { 0xA3, 0x00000001, false },    // Setting RGB888 as input format
+    { 0x0D, 0x00000002, true },     // Setting RGB888 as input format
+    { 0xA6, 0x00000000, false },    // Set Parallel bus polarity control HSYNC/VSYNC
+    { 0x0C, 0x0000001B, true },     // Set landscape nHD resolution
+    { 0xA3, 0x00000000, false },    // Setting RGB888 as input format
+    { 0x19, 0x000004FC, true },     // Setting RGB888 as input format
+    { 0x1E, 0x00000001, true },     // Locking sequence to VSYNC
+    { 0x0B, 0x00000000, true },     // Setting parallel input as a input source
+};
+
     const inline static int
-ti_i2c_read(uint8_t *data, uint8_t data_size, uint8_t addr)
+ti_i2c_read(struct dlpc_dev *dlpc, uint8_t *data, uint8_t data_size, uint8_t addr)
 {
     uint8_t subaddr[2] = {0x15, addr};
 
-    if (i2c_master_send(i2c_client, subaddr, 2) != 2) {
+    if (i2c_master_send(dlpc->client, subaddr, 2) != 2) {
         return -1;
     }
 
-    if (i2c_master_recv(i2c_client, data, data_size) != data_size) {
+    if (i2c_master_recv(dlpc->client, data, data_size) != data_size) {
         return -1;
     }
 
@@ -165,7 +266,7 @@ ti_i2c_read(uint8_t *data, uint8_t data_size, uint8_t addr)
 }
 
     const inline static int
-ti_i2c_write(uint8_t *data, uint8_t data_size, uint8_t addr)
+ti_i2c_write(struct dlpc_dev *dlpc, uint8_t *data, uint8_t data_size, uint8_t addr)
 {
     uint8_t data_b[5];
     data_b[0] = addr;
@@ -176,7 +277,7 @@ ti_i2c_write(uint8_t *data, uint8_t data_size, uint8_t addr)
 
     DEBUG_PRINTF("Sending 0x%X%X%X%X to %X addr\n", data[0], data[1], data[2], data[3], addr);
 
-    if (i2c_master_send(i2c_client, data_b, data_size + 1) < 0) {
+    if (i2c_master_send(dlpc->client, data_b, data_size + 1) < 0) {
         return -1;
     }
     DEBUG_PRINTF("Sent");
@@ -185,137 +286,188 @@ ti_i2c_write(uint8_t *data, uint8_t data_size, uint8_t addr)
     return 0;
 }
 
-const static int ti_i2c_curtain_on(void)
+/* The DLPC has no auto-increment, so every register is its own message,
+ * but the whole table goes out as one adapter transaction */
+static int ti_i2c_write_table(struct dlpc_dev *dlpc, const struct dlpc_reg *table,
+        int count)
+{
+    uint8_t buf[ARRAY_SIZE(dlpc_init_table)][DLPC_REG_SIZE + 1];
+    struct i2c_msg msgs[ARRAY_SIZE(dlpc_init_table)];
+    int i;
+
+    if (count > ARRAY_SIZE(dlpc_init_table)) {
+        return -EINVAL;
+    }
+
+    for (i=0; i<count; i++) {
+        buf[i][0] = table[i].addr;
+        uint32_to_bytes(table[i].val, &buf[i][1]);
+
+        msgs[i].addr = dlpc->client->addr;
+        msgs[i].flags = 0;
+        msgs[i].len = DLPC_REG_SIZE + 1;
+        msgs[i].buf = buf[i];
+    }
+
+    if (i2c_transfer(dlpc->client->adapter, msgs, count) == count) {
+        return 0;
+    }
+
+    DEBUG_PRINTF("Batched write failed, falling back to single writes\n");
+
+    for (i=0; i<count; i++) {
+        if (ti_i2c_write(dlpc, &buf[i][1], DLPC_REG_SIZE, table[i].addr) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static bool dlpc_is_configured(struct dlpc_dev *dlpc)
+{
+    uint8_t buf[DLPC_REG_SIZE];
+
+    for (int i=0; i<ARRAY_SIZE(dlpc_init_table); i++) {
+        if (!dlpc_init_table[i].verify) {
+            continue;
+        }
+
+        if (ti_i2c_read(dlpc, buf, DLPC_REG_SIZE, dlpc_init_table[i].addr) < 0) {
+            return false;
+        }
+
+        if (bytes_to_uint32(buf) != dlpc_init_table[i].val) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const static int ti_i2c_curtain_on(struct dlpc_dev *dlpc)
 {
     uint8_t buf[4];
     uint32_to_bytes(0x00000001, buf);
 
-    if (ti_i2c_write(buf, 0x04, 0xA6) < 0) {
+    if (ti_i2c_write(dlpc, buf, 0x04, DLPC_REG_CURTAIN) < 0) {
         return -1;
     }
 
     return 0;
 }
 
-const static int ti_i2c_curtain_off(void)
+const static int ti_i2c_curtain_off(struct dlpc_dev *dlpc)
 {
     uint8_t buf[4];
     uint32_to_bytes(0x00000000, buf);
 
-    if (ti_i2c_write(buf, 0x04, 0xA6) < 0) {
+    if (ti_i2c_write(dlpc, buf, 0x04, DLPC_REG_CURTAIN) < 0) {
         return -1;
     }
 
     return 0;
 }
 
-static int init_dev_i2c(void) {
+static int init_dev_i2c(struct dlpc_dev *dlpc) {
     u8 buf[4];
 
-    DEBUG_PRINTF("Bef uint32_to_bytes\n");
-    uint32_to_bytes(0x00000000, buf);
-
-    DEBUG_PRINTF("Bef first ti_i2c_write\n");
-    // Setting parallel input as a input source
-    if (ti_i2c_write(buf, 0x04, 0x0B) < 0) {
-        DEBUG_PRINTF("ti_i2c_write returned error\n");
-        return -1;
-    }
-    DEBUG_PRINTF("Aft first ti_i2c_write\n");
-
-    if (ti_i2c_read(buf, 0x04, 0x03) < 0) {
+    if (ti_i2c_read(dlpc, buf, 0x04, DLPC_REG_DEV_ID) < 0) {
         return -1;
     }
 
     // Sanity check basically checks the device ID in main status register
-    if (buf[3] != 0x8A) {
-        return -1;
-    }
-
-    // Setting RGB888 as input format
-    uint32_to_bytes(0x00000001, buf);
-    if (ti_i2c_write(buf, 0x04, 0xA3) < 0) {
+    if (buf[3] != DLPC_DEV_ID) {
         return -1;
     }
 
-    // Setting RGB888 as input format
-    uint32_to_bytes(0x00000002, buf);
-    if (ti_i2c_write(buf, 0x04, 0x0D) < 0) {
-        return -1;
+    if (dlpc_is_configured(dlpc)) {
+        DEBUG_PRINTF("DLPC already configured, skipping init table\n");
+        return ti_i2c_curtain_on(dlpc);
     }
 
-    // Set Parallel bus polarity control HSYNC/VSYNC
-    uint32_to_bytes(0x00000000, buf);
-    if (ti_i2c_write(buf, 0x04, 0xA6) < 0) {
+    if (ti_i2c_write_table(dlpc, dlpc_init_table, ARRAY_SIZE(dlpc_init_table)) < 0) {
+        DEBUG_PRINTF("ti_i2c_write_table returned error\n");
         return -1;
     }
 
-    // Set landscape nHD resolution
-    uint32_to_bytes(0x0000001B, buf);
-    if (ti_i2c_write(buf, 0x04, 0x0C) < 0) {
-        return -1;
-    }
+    return ti_i2c_curtain_on(dlpc);
+}
 
-    // Setting RGB888 as input format
-    uint32_to_bytes(0x00000000, buf);
-    if (ti_i2c_write(buf, 0x04, 0xA3) < 0) {
-        return -1;
-    }
+/* PROJ_RDY idles high and falls at the end of the DLPC boot */
+static int ti_proj_rdy(struct dlpc_dev *dlpc)
+{
+    return gpiod_get_raw_value(dlpc->proj_rdy) == 0;
+}
 
-    // Setting RGB888 as input format
-    uint32_to_bytes(0x000004FC, buf);
-    if (ti_i2c_write(buf, 0x04, 0x19) < 0) {
-        return -1;
-    }
+/*
+ * gpio_irq_handler sets the flag on the falling edge. With level the line
+ * is checked as well, for a DLPC that was up before the IRQ was requested;
+ * right after PROJ_EN went up it may still be low from before.
+ */
+static int ti_wait_proj_rdy(struct dlpc_dev *dlpc, bool level)
+{
+    int ret;
 
-    // Locking sequence to VSYNC
-    uint32_to_bytes(0x00000001, buf);
-    if (ti_i2c_write(buf, 0x04, 0x1E) < 0) {
-        return -1;
-    }
+    ret = wait_event_interruptible_timeout(dlpc->event_wait,
+            dlpc->event_occurred != 0 || (level && ti_proj_rdy(dlpc)),
+            msecs_to_jiffies(EVM2000_PROJ_ON_TIMEOUT_S * 1000));
 
-    // Setting parallel input as a input source
-    uint32_to_bytes(0x00000000, buf);
-    if (ti_i2c_write(buf, 0x04, 0x0B) < 0) {
-        return -1;
+    if (ret < 0) {
+        return ret;
+    } else if (ret == 0) {
+        return -ETIMEDOUT;
     }
 
-    ti_i2c_curtain_on();
-
     return 0;
 }
 
-const static int ti_i2c_off(void)
+const static int ti_i2c_off(struct dlpc_dev *dlpc)
 {
-    gpiod_set_raw_value(proj_en, 0);
+    gpiod_set_raw_value(dlpc->proj_en, 0);
 
     return 0;
 }
 
-const static int ti_i2c_on(void)
+const static int ti_i2c_on(struct dlpc_dev *dlpc)
 {
-    gpiod_set_raw_value(proj_en, 1);
+    bool up = gpiod_get_raw_value(dlpc->proj_en);
+    int ret;
 
-    msleep(300);
+    // Already powered, there is no edge to wait for
+    dlpc->event_occurred = 0;
+    if (!up) {
+        gpiod_set_raw_value(dlpc->proj_en, 1);
+    }
 
-    init_dev_i2c();
+    ret = ti_wait_proj_rdy(dlpc, up);
+    if (ret < 0) {
+        pr_err("PROJ_RDY not seen within %ds\n", EVM2000_PROJ_ON_TIMEOUT_S);
+        return ret;
+    }
+
+    if (init_dev_i2c(dlpc) < 0) {
+        return -EIO;
+    }
 
     return 0;
 }
 
-const static int ti_i2c_reset(void)
+const static int ti_i2c_reset(struct dlpc_dev *dlpc)
 {
-    if (ti_i2c_off()) {
+    if (ti_i2c_off(dlpc)) {
         return -1;
     }
 
-    return ti_i2c_on();
+    return ti_i2c_on(dlpc);
 }
 
 static irqreturn_t gpio_irq_handler(int irq, void *dev_id)
 {
-    gpio_event_occurred = 1;
-    wake_up_interruptible(&gpio_event_wait);
+    struct dlpc_dev *dlpc = dev_id;
+
+    dlpc->event_occurred = 1;
+    wake_up_interruptible(&dlpc->event_wait);
 
     return IRQ_HANDLED;
 }
@@ -385,6 +537,7 @@ struct lcdc_fb_data {
 
     wait_queue_head_t   palette_wait;
     int         palette_loaded_flag;
+    unsigned int        mono_channels;
 
     unsigned int        which_dma_channel_done;
 #ifdef CONFIG_CPU_FREQ
@@ -396,6 +549,43 @@ struct lcdc_fb_data {
     struct fb_videomode mode;
     struct lcd_ctrl_config  cfg;
     struct device_node *hdmi_node;
+
+    void __iomem        *reg_base;
+    unsigned int        lcd_rev;
+    int                 instance;
+    struct dlpc_dev     *dlpc;
+    wait_queue_head_t   frame_done_wq;
+    int                 frame_done_flag;
+    vsync_callback_t    vsync_cb_handler;
+    void                *vsync_cb_arg;
+
+    struct mutex        dma_cfg_lock;
+    bool                removing;       // under dma_cfg_lock, nothing may arm dma_tune_work
+    /* DMA config waiting for the raster to be stopped anyway, under dma_cfg_spin */
+    spinlock_t          dma_cfg_spin;
+    bool                dma_cfg_pending;
+    int                 dma_next_burst_sz;
+    int                 dma_next_fifo_th;
+    atomic_t            underflow_count;
+    atomic_t            frame_count;
+    bool                dma_autotune;
+    struct delayed_work dma_tune_work;
+    unsigned int        dma_tune_last_underflows;
+    unsigned int        dma_tune_clean_periods;
+    int                 dma_best_burst_sz;
+    int                 dma_best_fifo_th;
+
+    /* Curtain state as last written to the DLPC, -1 when unknown */
+    int                 curtain_state;
+    int                 curtain_target;
+    int                 curtain_vsyncs_left;
+    bool                curtain_busy;
+    u64                 curtain_vsync_ns;
+    u64                 curtain_done_ns;
+    spinlock_t          curtain_lock;
+    struct mutex        curtain_i2c_lock;
+    struct work_struct  curtain_work;
+    wait_queue_head_t   curtain_wait;
 };
 
 struct lcdc_platform_data {
@@ -421,9 +611,7 @@ static struct fb_videomode lcd_panels[] = {
     },
 };
 
-static struct fb_var_screeninfo lcdc_fb_var;
-
-static struct fb_fix_screeninfo lcdc_fb_fix = {
+static const struct fb_fix_screeninfo lcdc_fb_fix_default = {
     .id         = "EVM2000 FB Drv",
     .type       = FB_TYPE_PACKED_PIXELS,
     .type_aux   = 0,
@@ -434,129 +622,185 @@ static struct fb_fix_screeninfo lcdc_fb_fix = {
     .accel      = FB_ACCEL_NONE
 };
 
-static vsync_callback_t vsync_cb_handler;
-static void *vsync_cb_arg;
-
-static void __iomem *ocp_reg_base;
-static void __iomem *lcdc_fb_reg_base;
-static unsigned int lcd_rev;
-static irq_handler_t lcdc_irq_handler;
-static wait_queue_head_t frame_done_wq;
-static int frame_done_flag;
+/* Probed instances by index, for register_vsync_cb() */
+static struct lcdc_fb_data *lcdc_instances[LCDC_MAX_INSTANCES];
+static DEFINE_MUTEX(lcdc_instances_lock);
 
-static void lcdc_write(unsigned int val, unsigned int addr)
+static void lcdc_write(struct lcdc_fb_data *par, unsigned int val, unsigned int addr)
 {
-    __raw_writel(val, (volatile void __iomem *)lcdc_fb_reg_base + (addr));
+    __raw_writel(val, (volatile void __iomem *)par->reg_base + (addr));
 }
 
-static unsigned int lcdc_read(unsigned int addr)
+static unsigned int lcdc_read(struct lcdc_fb_data *par, unsigned int addr)
 {
-    DEBUG_PRINTF("Reading from %px\n",lcdc_fb_reg_base + (addr));
-    return (unsigned int)readl(lcdc_fb_reg_base + (addr));
+    DEBUG_PRINTF("Reading from %px\n",par->reg_base + (addr));
+    return (unsigned int)readl(par->reg_base + (addr));
+}
+
+static bool lcdc_is_raster_enabled(struct lcdc_fb_data *par) {
+    return ((lcdc_read(par, LCD_RASTER_CTRL_REG) & LCD_RASTER_ENABLE) != 0);
 }
 
-static bool lcdc_is_raster_enabled(void) {
-    return ((lcdc_read(LCD_RASTER_CTRL_REG) & LCD_RASTER_ENABLE) != 0);
+static int lcd_cfg_dma(struct lcdc_fb_data *par, int burst_size, int fifo_th);
+
+/* Takes a DMA config latched by lcdc_apply_dma_cfg(), only with the raster off */
+static void lcdc_latch_dma_cfg(struct lcdc_fb_data *par)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&par->dma_cfg_spin, flags);
+
+    if (par->dma_cfg_pending) {
+        par->cfg.dma_burst_sz = par->dma_next_burst_sz;
+        par->cfg.fifo_th = par->dma_next_fifo_th;
+        lcd_cfg_dma(par, par->cfg.dma_burst_sz, par->cfg.fifo_th);
+        par->dma_cfg_pending = false;
+    }
+
+    spin_unlock_irqrestore(&par->dma_cfg_spin, flags);
 }
 
-static void lcdc_enable_raster(void)
+static void lcdc_enable_raster(struct lcdc_fb_data *par)
 {
     u32 reg;
 
-    if (lcd_rev == LCD_VERSION_2) {
-        lcdc_write(LCD_CLK_MAIN_RESET, LCD_CLK_RESET_REG);
+    lcdc_latch_dma_cfg(par);
+
+    if (par->lcd_rev == LCD_VERSION_2) {
+        lcdc_write(par, LCD_CLK_MAIN_RESET, LCD_CLK_RESET_REG);
     }
 
     mdelay(1);
 
-    if (lcd_rev == LCD_VERSION_2) {
-        lcdc_write(0, LCD_CLK_RESET_REG);
+    if (par->lcd_rev == LCD_VERSION_2) {
+        lcdc_write(par, 0, LCD_CLK_RESET_REG);
     }
 
     mdelay(1);
 
-    reg = lcdc_read(LCD_RASTER_CTRL_REG);
+    reg = lcdc_read(par, LCD_RASTER_CTRL_REG);
     if (!(reg & LCD_RASTER_ENABLE)) {
-        lcdc_write(reg | LCD_RASTER_ENABLE, LCD_RASTER_CTRL_REG);
+        lcdc_write(par, reg | LCD_RASTER_ENABLE, LCD_RASTER_CTRL_REG);
     }
 } 
 
-static void lcdc_disable_raster(enum lcdc_frame_complete wait_for_frame_done)
+static void lcdc_disable_raster(struct lcdc_fb_data *par, enum lcdc_frame_complete wait_for_frame_done)
 {
     u32 reg;
-    reg = lcdc_read(LCD_RASTER_CTRL_REG);
+    reg = lcdc_read(par, LCD_RASTER_CTRL_REG);
 
     if (reg & LCD_RASTER_ENABLE) {
-        lcdc_write(reg & ~LCD_RASTER_ENABLE, LCD_RASTER_CTRL_REG);
+        lcdc_write(par, reg & ~LCD_RASTER_ENABLE, LCD_RASTER_CTRL_REG);
     }
 
     if ((wait_for_frame_done == LCDC_FRAME_WAIT) &&
-            (lcd_rev == LCD_VERSION_2)) {
-        frame_done_flag = 0;
-        int ret = wait_event_interruptible_timeout(frame_done_wq,
-                frame_done_flag != 0,
+            (par->lcd_rev == LCD_VERSION_2)) {
+        par->frame_done_flag = 0;
+        int ret = wait_event_interruptible_timeout(par->frame_done_wq,
+                par->frame_done_flag != 0,
                 msecs_to_jiffies(50));
         if (ret == 0)
             pr_err("LCD Controller timed out\n");
     }
 }
 
-// Not used rn
-//static void lcdc_blit(int load_mode, struct lcdc_fb_data *par)
-//{
-//    u32 start;
-//    u32 end;
-//    u32 reg_ras;
-//    u32 reg_dma;
-//    u32 reg_int;
-//
-//    reg_ras = lcdc_read(LCD_RASTER_CTRL_REG);
-//    reg_ras &= ~(3 << 20);
-//
-//    reg_dma = lcdc_read(LCD_DMA_CTRL_REG);
-//
-//    if (load_mode == LOAD_DATA) {
-//        start   = par->dma_start;
-//        end     = par->dma_end;
-//
-//        reg_ras |= LCD_PALETTE_LOAD_MODE(DATA_ONLY);
-//
-//        if (lcd_rev == LCD_VERSION_1) {
-//            reg_dma |= LCD_V1_END_OF_FRAME_INT_ENA;
-//        } else {
-//            reg_int = lcdc_read(LCD_INT_ENABLE_SET_REG) |
-//                LCD_V2_END_OF_FRAME0_INT_ENA |
-//                LCD_V2_END_OF_FRAME1_INT_ENA |
-//                LCD_FRAME_DONE | LCD_SYNC_LOST;
-//            lcdc_write(reg_int, LCD_INT_ENABLE_SET_REG);
-//        }
-//
-//        reg_dma |= LCD_DUAL_FRAME_BUFFER_ENABLE;
-//
-//        lcdc_write(start, LCD_DMA_FRM_BUF_BASE_ADDR_0_REG);
-//        lcdc_write(end, LCD_DMA_FRM_BUF_BASE_ADDR_0_REG);
-//        lcdc_write(start, LCD_DMA_FRM_BUF_BASE_ADDR_1_REG);
-//        lcdc_write(end, LCD_DMA_FRM_BUF_BASE_ADDR_1_REG);
-//    } else if ( load_mode == LOAD_PALETTE){
-//        // TODO: add palette mode
-//    }
-//
-//    lcdc_write(reg_dma, LCD_DMA_CTRL_REG);
-//    lcdc_write(reg_ras, LCD_RASTER_CTRL_REG);
-//
-//    lcdc_enable_raster();
-//}
+static void lcdc_blit(struct lcdc_fb_data *par, int load_mode)
+{
+    u32 reg_ras;
+    u32 reg_int;
+
+    reg_ras = lcdc_read(par, LCD_RASTER_CTRL_REG);
+    reg_ras &= ~(LCD_PALETTE_LOAD_MODE(3) | LCD_RASTER_ENABLE);
+
+    if (load_mode == LOAD_DATA) {
+        reg_ras |= LCD_PALETTE_LOAD_MODE(DATA_ONLY);
+
+        lcdc_write(par, par->dma_start, LCD_DMA_FRM_BUF_BASE_ADDR_0_REG);
+        lcdc_write(par, par->dma_end, LCD_DMA_FRM_BUF_CEILING_ADDR_0_REG);
+        lcdc_write(par, par->dma_start, LCD_DMA_FRM_BUF_BASE_ADDR_1_REG);
+        lcdc_write(par, par->dma_end, LCD_DMA_FRM_BUF_CEILING_ADDR_1_REG);
+    } else if (load_mode == LOAD_PALETTE) {
+        reg_ras |= LCD_PALETTE_LOAD_MODE(PALETTE_ONLY);
+
+        if (par->lcd_rev == LCD_VERSION_1) {
+            reg_ras |= LCD_V1_PL_INT_ENA;
+        } else {
+            reg_int = lcdc_read(par, LCD_INT_ENABLE_SET_REG) |
+                LCD_V2_PL_INT_ENA;
+            lcdc_write(par, reg_int, LCD_INT_ENABLE_SET_REG);
+        }
+
+        lcdc_write(par, par->p_palette_base, LCD_DMA_FRM_BUF_BASE_ADDR_0_REG);
+        lcdc_write(par, par->p_palette_base + par->palette_sz - 1,
+                LCD_DMA_FRM_BUF_CEILING_ADDR_0_REG);
+    }
+
+    lcdc_write(par, reg_ras, LCD_RASTER_CTRL_REG);
+
+    lcdc_enable_raster(par);
+}
+
+/*
+ * Palette entries are 12 bit RGB 4:4:4, the intensity goes to the enabled
+ * channels. Only its top 4 bits fit, so 8bpp gives 16 grey levels; finer
+ * doses have to come from bit planes shown for binary weighted times.
+ */
+static void lcdc_fill_mono_palette(struct lcdc_fb_data *par)
+{
+    unsigned short *palette = (unsigned short *)par->v_palette_base;
+    unsigned short v;
+    int i;
+
+    for (i=0; i<PALETTE_SIZE; i++) {
+        v = i >> 4;
+
+        palette[i] = 0;
+        if (par->mono_channels & MONO_CHANNEL_R) {
+            palette[i] |= v << 8;
+        }
+        if (par->mono_channels & MONO_CHANNEL_G) {
+            palette[i] |= v << 4;
+        }
+        if (par->mono_channels & MONO_CHANNEL_B) {
+            palette[i] |= v;
+        }
+    }
+
+    palette[0] |= PALETTE_BPP_8;
+}
 
 static void lcdc_load_palette(struct lcdc_fb_data *par)
 {
-    // TODO: add palette mode
+    u32 reg_ras;
+    int ret;
+
+    if (par->cfg.bpp > 8) {
+        // Keep the palette and data load mode used for true color
+        reg_ras = lcdc_read(par, LCD_RASTER_CTRL_REG) & ~LCD_PALETTE_LOAD_MODE(3);
+        lcdc_write(par, reg_ras | LCD_PALETTE_LOAD_MODE(PALETTE_AND_DATA),
+                LCD_RASTER_CTRL_REG);
+        return;
+    }
+
+    lcdc_disable_raster(par, LCDC_FRAME_WAIT);
+
+    par->palette_loaded_flag = 0;
+    lcdc_blit(par, LOAD_PALETTE);
+
+    // The PL_LOAD_DONE interrupt switches over to LOAD_DATA
+    ret = wait_event_interruptible_timeout(par->palette_wait,
+            par->palette_loaded_flag != 0,
+            msecs_to_jiffies(50));
+    if (ret == 0) {
+        dev_err(par->dev, "Palette load timed out\n");
+    }
 }
 
-static int lcd_cfg_dma(int burst_size, int fifo_th)
+static int lcd_cfg_dma(struct lcdc_fb_data *par, int burst_size, int fifo_th)
 {
     u32 reg;
 
-    reg = lcdc_read(LCD_DMA_CTRL_REG) & 0x00000001;
+    reg = lcdc_read(par, LCD_DMA_CTRL_REG) & 0x00000001;
     switch (burst_size) {
         case 1:
             reg |= LCD_DMA_BURST_SIZE(LCD_DMA_BURST_1);
@@ -578,64 +822,147 @@ static int lcd_cfg_dma(int burst_size, int fifo_th)
 
     reg |= (fifo_th << 8);
 
-    lcdc_write(reg, LCD_DMA_CTRL_REG);
+    lcdc_write(par, reg, LCD_DMA_CTRL_REG);
     return 0;
 }
 
-static void lcd_cfg_ac_bias(int period, int transitions_per_int)
+/* The burst is already at its largest by default, only the FIFO threshold is stepped */
+static int lcdc_next_dma_cfg(int *fifo_th)
+{
+    if (*fifo_th < LCD_DMA_FIFO_TH_MAX) {
+        (*fifo_th)++;
+        return 0;
+    }
+
+    return -ERANGE;
+}
+
+/*
+ * Restarting the raster for it would blank the projector mid exposure, so
+ * a running raster takes the config at its next restart: a mode set, an
+ * unblank or an underflow recovery
+ */
+static void lcdc_apply_dma_cfg(struct lcdc_fb_data *par, int burst_size, int fifo_th)
+{
+    unsigned long flags;
+
+    mutex_lock(&par->dma_cfg_lock);
+
+    // Clocks may be off already, stay away from the registers
+    if (par->removing) {
+        mutex_unlock(&par->dma_cfg_lock);
+        return;
+    }
+
+    spin_lock_irqsave(&par->dma_cfg_spin, flags);
+    par->dma_next_burst_sz = burst_size;
+    par->dma_next_fifo_th = fifo_th;
+    par->dma_cfg_pending = true;
+    spin_unlock_irqrestore(&par->dma_cfg_spin, flags);
+
+    if (!lcdc_is_raster_enabled(par)) {
+        lcdc_latch_dma_cfg(par);
+    }
+
+    mutex_unlock(&par->dma_cfg_lock);
+}
+
+static void lcdc_dma_tune_work(struct work_struct *work)
+{
+    struct lcdc_fb_data *par = container_of(to_delayed_work(work),
+            struct lcdc_fb_data, dma_tune_work);
+    unsigned int underflows = atomic_read(&par->underflow_count);
+    unsigned int delta = underflows - par->dma_tune_last_underflows;
+    int fifo_th = par->cfg.fifo_th;
+
+    par->dma_tune_last_underflows = underflows;
+
+    if (!par->dma_autotune) {
+        return;
+    }
+
+    if (READ_ONCE(par->dma_cfg_pending)) {
+        // Last step not in effect yet, these underflows are still the old config's
+        par->dma_tune_clean_periods = 0;
+    } else if (delta >= DMA_TUNE_UNDERFLOW_TH) {
+        par->dma_tune_clean_periods = 0;
+
+        if (lcdc_next_dma_cfg(&fifo_th) == 0) {
+            DEBUG_PRINTF("DMA tune: %u underflows, fifo_th %d->%d\n",
+                    delta, par->cfg.fifo_th, fifo_th);
+            lcdc_apply_dma_cfg(par, par->cfg.dma_burst_sz, fifo_th);
+        } else {
+            dev_warn(par->dev, "DMA tune: underflows at max fifo threshold\n");
+        }
+    } else if (delta == 0 &&
+            ++par->dma_tune_clean_periods == DMA_TUNE_STABLE_PERIODS) {
+        par->dma_best_burst_sz = par->cfg.dma_burst_sz;
+        par->dma_best_fifo_th = par->cfg.fifo_th;
+        dev_info(par->dev, "DMA tune: burst %d, fifo_th %d clean for %d periods\n",
+                par->dma_best_burst_sz, par->dma_best_fifo_th,
+                DMA_TUNE_STABLE_PERIODS);
+    } else if (delta != 0) {
+        par->dma_tune_clean_periods = 0;
+    }
+
+    schedule_delayed_work(&par->dma_tune_work,
+            msecs_to_jiffies(DMA_TUNE_PERIOD_MS));
+}
+
+static void lcd_cfg_ac_bias(struct lcdc_fb_data *par, int period, int transitions_per_int)
 {
     u32 reg;
 
-    reg = lcdc_read(LCD_RASTER_TIMING_2_REG) & 0xFFF00000;
+    reg = lcdc_read(par, LCD_RASTER_TIMING_2_REG) & 0xFFF00000;
     reg |= LCD_AC_BIAS_FREQUENCY(period) |
         LCD_AC_BIAS_TRANSITIONS_PER_INT(transitions_per_int);
 
-    lcdc_write(reg, LCD_RASTER_TIMING_2_REG);
+    lcdc_write(par, reg, LCD_RASTER_TIMING_2_REG);
 }
 
-static void lcd_cfg_horizontal_sync(int back_porch, int pulse_width, int front_porch)
+static void lcd_cfg_horizontal_sync(struct lcdc_fb_data *par, int back_porch, int pulse_width, int front_porch)
 {
     u32 reg;
 
     DEBUG_PRINTF("Horizontal back_porch:%u, pulse_width:%u, front_porch:%u\n", 
             back_porch, pulse_width, front_porch);
 
-    reg = lcdc_read(LCD_RASTER_TIMING_0_REG) & 0xF;
+    reg = lcdc_read(par, LCD_RASTER_TIMING_0_REG) & 0xF;
     reg |= (((back_porch-1) & 0xFF) << 24)
         | (((front_porch-1) & 0xFF) << 16)
         | (((pulse_width-1) & 0x3F) << 10);
-    lcdc_write(reg, LCD_RASTER_TIMING_0_REG);
+    lcdc_write(par, reg, LCD_RASTER_TIMING_0_REG);
 
-    if (lcd_rev == LCD_VERSION_2) {
-        reg = lcdc_read(LCD_RASTER_TIMING_2_REG) & ~0x780000FF;
+    if (par->lcd_rev == LCD_VERSION_2) {
+        reg = lcdc_read(par, LCD_RASTER_TIMING_2_REG) & ~0x780000FF;
         reg |= (((front_porch-1) & 0x300) >> 8);
         reg |= (((back_porch-1) & 0x300) >> 4);
         reg |= (((pulse_width-1) & 0x3C0) << 21);
-        lcdc_write(reg, LCD_RASTER_TIMING_2_REG);
+        lcdc_write(par, reg, LCD_RASTER_TIMING_2_REG);
     }
 }
 
-static int lcd_cfg_vertical_sync(int back_porch, int pulse_width, int front_porch)
+static int lcd_cfg_vertical_sync(struct lcdc_fb_data *par, int back_porch, int pulse_width, int front_porch)
 {
     u32 reg;
 
     DEBUG_PRINTF("Vertical back_porch:%u, pulse_width:%u, front_porch:%u\n", 
             back_porch, pulse_width, front_porch);
-    reg = lcdc_read(LCD_RASTER_TIMING_1_REG) & 0x3FF;
+    reg = lcdc_read(par, LCD_RASTER_TIMING_1_REG) & 0x3FF;
     reg |= ((back_porch & 0xFF) << 24)
         | ((front_porch & 0xFF) << 16)
         | (((pulse_width-1) & 0x3F) << 10);
-    lcdc_write(reg, LCD_RASTER_TIMING_1_REG);
+    lcdc_write(par, reg, LCD_RASTER_TIMING_1_REG);
 
     return 0;
 }
 
-static int lcd_cfg_display(const struct lcd_ctrl_config *cfg, struct fb_videomode *panel)
+static int lcd_cfg_display(struct lcdc_fb_data *par, const struct lcd_ctrl_config *cfg, struct fb_videomode *panel)
 {
     u32 reg;
     u32 reg_int;
 
-    reg = lcdc_read(LCD_RASTER_CTRL_REG) & ~(LCD_TFT_MODE 
+    reg = lcdc_read(par, LCD_RASTER_CTRL_REG) & ~(LCD_TFT_MODE 
             | LCD_MONO_8BIT_MODE 
             | LCD_MONOCHROME_MODE);
 
@@ -653,7 +980,7 @@ static int lcd_cfg_display(const struct lcd_ctrl_config *cfg, struct fb_videomod
             }
             break;
         case COLOR_PASSIVE:
-            lcd_cfg_ac_bias(cfg->ac_bias, cfg->ac_bias_intrpt);
+            lcd_cfg_ac_bias(par, cfg->ac_bias, cfg->ac_bias_intrpt);
             if (cfg->bpp == 12 && cfg->stn_565_mode) {
                 reg |= LCD_STN_565_ENABLE;
             }
@@ -663,17 +990,17 @@ static int lcd_cfg_display(const struct lcd_ctrl_config *cfg, struct fb_videomod
             return -EINVAL;
     }
 
-    if (lcd_rev == LCD_VERSION_1) {
+    if (par->lcd_rev == LCD_VERSION_1) {
         reg |= LCD_V1_UNDERFLOW_INT_ENA;
     } else {
-        reg_int = lcdc_read(LCD_INT_ENABLE_SET_REG) |
+        reg_int = lcdc_read(par, LCD_INT_ENABLE_SET_REG) |
             LCD_V2_UNDERFLOW_INT_ENA;
-        lcdc_write(reg_int, LCD_INT_ENABLE_SET_REG);
+        lcdc_write(par, reg_int, LCD_INT_ENABLE_SET_REG);
     }
 
-    lcdc_write(reg, LCD_RASTER_CTRL_REG);
+    lcdc_write(par, reg, LCD_RASTER_CTRL_REG);
 
-    reg = lcdc_read(LCD_RASTER_TIMING_2_REG);
+    reg = lcdc_read(par, LCD_RASTER_TIMING_2_REG);
 
     reg |= LCD_SYNC_CTRL;
 
@@ -695,7 +1022,7 @@ static int lcd_cfg_display(const struct lcd_ctrl_config *cfg, struct fb_videomod
         reg &= ~LCD_INVERT_FRAME_CLOCK;
     }
 
-    lcdc_write(reg, LCD_RASTER_TIMING_2_REG);
+    lcdc_write(par, reg, LCD_RASTER_TIMING_2_REG);
 
     return 0;
 }
@@ -705,13 +1032,13 @@ static int lcd_cfg_frame_buffer(struct lcdc_fb_data *par, u32 width, u32 height,
 {
     u32 reg;
 
-    if (bpp > 16 && lcd_rev == LCD_VERSION_1) {
+    if (bpp > 16 && par->lcd_rev == LCD_VERSION_1) {
         return -EINVAL;
     }
 
     DEBUG_PRINTF("width_pre:%u\n", width);
 
-    if (lcd_rev == LCD_VERSION_1) {
+    if (par->lcd_rev == LCD_VERSION_1) {
         width &= 0x3F0;
     } else {
         width &= 0x7F0;
@@ -719,36 +1046,36 @@ static int lcd_cfg_frame_buffer(struct lcdc_fb_data *par, u32 width, u32 height,
 
     DEBUG_PRINTF("width_post:%u\n", width);
 
-    reg = lcdc_read(LCD_RASTER_TIMING_0_REG);
+    reg = lcdc_read(par, LCD_RASTER_TIMING_0_REG);
     reg &= 0xFFFFFC00;
 
-    if (lcd_rev == LCD_VERSION_1) {
+    if (par->lcd_rev == LCD_VERSION_1) {
         reg |= ((width >> 4) - 1) << 4;
     } else {
         width = ((width - 1) >> 4);
         reg |= ((width & 0x3F) << 4) | ((width & 0x40) >> 3);
     }
 
-    lcdc_write(reg, LCD_RASTER_TIMING_0_REG);
+    lcdc_write(par, reg, LCD_RASTER_TIMING_0_REG);
 
-    reg = lcdc_read(LCD_RASTER_TIMING_1_REG);
+    reg = lcdc_read(par, LCD_RASTER_TIMING_1_REG);
     reg = ((height - 1) & 0x3FF) | (reg & 0xFFFFFC00);
-    lcdc_write(reg, LCD_RASTER_TIMING_1_REG);
+    lcdc_write(par, reg, LCD_RASTER_TIMING_1_REG);
 
-    if (lcd_rev == LCD_VERSION_2) {
-        reg = lcdc_read(LCD_RASTER_TIMING_2_REG);
+    if (par->lcd_rev == LCD_VERSION_2) {
+        reg = lcdc_read(par, LCD_RASTER_TIMING_2_REG);
         reg |= ((height - 1) & 0x400) << 16;
-        lcdc_write(reg, LCD_RASTER_TIMING_2_REG);
+        lcdc_write(par, reg, LCD_RASTER_TIMING_2_REG);
     }
 
-    reg = lcdc_read(LCD_RASTER_CTRL_REG) & ~(1 << 8);
+    reg = lcdc_read(par, LCD_RASTER_CTRL_REG) & ~(1 << 8);
     if (raster_order) {
         reg |= LCD_RASTER_ORDER;
     }
 
     par->palette_sz = 16*2;
 
-    if (lcd_rev == LCD_VERSION_2) {
+    if (par->lcd_rev == LCD_VERSION_2) {
         reg &= ~LCD_V2_TFT_24BPP_MODE;
         reg &= ~LCD_V2_TFT_24BPP_UNPACK;
     }
@@ -773,7 +1100,7 @@ static int lcd_cfg_frame_buffer(struct lcdc_fb_data *par, u32 width, u32 height,
             return -EINVAL;
     }
 
-    lcdc_write(reg, LCD_RASTER_CTRL_REG);
+    lcdc_write(par, reg, LCD_RASTER_CTRL_REG);
 
     return 0;
 }
@@ -795,7 +1122,7 @@ static int fb_setcolreg(unsigned regno, unsigned red, unsigned green, unsigned b
         return 1;
     }
 
-    if (info->var.bits_per_pixel > 16 && lcd_rev == LCD_VERSION_1) {
+    if (info->var.bits_per_pixel > 16 && par->lcd_rev == LCD_VERSION_1) {
         return -EINVAL;
     }
 
@@ -836,6 +1163,10 @@ static int fb_setcolreg(unsigned regno, unsigned red, unsigned green, unsigned b
                     pal |= green & 0x00f0;
                     pal |= blue & 0x000f;
 
+                    if (regno == 0) {
+                        pal |= PALETTE_BPP_8;
+                    }
+
                     if (palette[regno] != pal) {
                         update_hw = 1;
                         palette[regno] = pal;
@@ -865,9 +1196,9 @@ static int fb_setcolreg(unsigned regno, unsigned red, unsigned green, unsigned b
                 ((u32 *) (info->pseudo_palette))[regno] = v;
                 break;
         }
-        if (palette[0] != 0x4000) {
+        if (palette[0] != PALETTE_BPP_12_24) {
             update_hw = 1;
-            palette[0] = 0x4000;
+            palette[0] = PALETTE_BPP_12_24;
         }
     }
 
@@ -879,15 +1210,15 @@ static int fb_setcolreg(unsigned regno, unsigned red, unsigned green, unsigned b
 }
 #undef CNVT_TOHW
 
-static void lcdc_fb_lcd_reset(void)
+static void lcdc_fb_lcd_reset(struct lcdc_fb_data *par)
 {
-    lcdc_write(0, LCD_DMA_CTRL_REG);
-    lcdc_write(0, LCD_RASTER_CTRL_REG);
+    lcdc_write(par, 0, LCD_DMA_CTRL_REG);
+    lcdc_write(par, 0, LCD_RASTER_CTRL_REG);
 
-    if (lcd_rev == LCD_VERSION_2) {
-        lcdc_write(0, LCD_INT_ENABLE_SET_REG);
-        lcdc_write(LCD_CLK_MAIN_RESET, LCD_CLK_RESET_REG);
-        lcdc_write(0, LCD_CLK_RESET_REG);
+    if (par->lcd_rev == LCD_VERSION_2) {
+        lcdc_write(par, 0, LCD_INT_ENABLE_SET_REG);
+        lcdc_write(par, LCD_CLK_MAIN_RESET, LCD_CLK_RESET_REG);
+        lcdc_write(par, 0, LCD_CLK_RESET_REG);
     }
 }
 
@@ -910,11 +1241,11 @@ static void lcdc_fb_lcd_reset(void)
 //    }
 //
 //    /* Configure the LCD clock divisor. */
-//    lcdc_write(LCD_CLK_DIVISOR(lcdc_clk_div) |
+//    lcdc_write(par, LCD_CLK_DIVISOR(lcdc_clk_div) |
 //            (LCD_RASTER_MODE & 0x1), LCD_CTRL_REG);
 //
-//    if (lcd_rev == LCD_VERSION_2)
-//        lcdc_write(LCD_V2_DMA_CLK_EN | LCD_V2_LIDD_CLK_EN |
+//    if (par->lcd_rev == LCD_VERSION_2)
+//        lcdc_write(par, LCD_V2_DMA_CLK_EN | LCD_V2_LIDD_CLK_EN |
 //                LCD_V2_CORE_CLK_EN, LCD_CLK_ENABLE_REG);
 //
 //    return 0;
@@ -926,8 +1257,7 @@ static unsigned int lcdc_fb_calc_clk_divider(struct lcdc_fb_data *par,
 {
     unsigned lcdc_clk_div;
 
-    lcdc_fb_var.pixclock = 15000000; // TODO change this to read from devicetree
-    pixclock = lcdc_fb_var.pixclock;
+    pixclock = 15000000; // TODO change this to read from devicetree
 
     *lcdc_clk_rate = par->lcdc_clk_rate;
 
@@ -971,10 +1301,10 @@ static int lcdc_fb_calc_config_clk_divider(struct lcdc_fb_data *par,
     }
 
     // Configure the divider
-    lcdc_write(LCD_CLK_DIVISOR(div) | LCD_RASTER_MODE, LCD_CTRL_REG);
+    lcdc_write(par, LCD_CLK_DIVISOR(div) | LCD_RASTER_MODE, LCD_CTRL_REG);
 
-    if (lcd_rev == LCD_VERSION_2) {
-        lcdc_write(LCD_V2_DMA_CLK_EN | LCD_V2_LIDD_CLK_EN |
+    if (par->lcd_rev == LCD_VERSION_2) {
+        lcdc_write(par, LCD_V2_DMA_CLK_EN | LCD_V2_LIDD_CLK_EN |
                 LCD_V2_CORE_CLK_EN, LCD_CLK_ENABLE_REG);
     }
 
@@ -1015,11 +1345,11 @@ static int lcd_init(struct lcdc_fb_data *par,
         par->lcdc_clk_rate = clk_get_rate(par->lcdc_clk);
         pixclock = par->lcdc_clk_rate / clkdiv;
 
-        lcdc_write(LCD_CLK_DIVISOR(clkdiv) | 
+        lcdc_write(par, LCD_CLK_DIVISOR(clkdiv) | 
                 (LCD_RASTER_MODE & 0x1), LCD_CTRL_REG);
 
-        if (lcd_rev == LCD_VERSION_2) {
-            lcdc_write(LCD_V2_DMA_CLK_EN | LCD_V2_LIDD_CLK_EN |
+        if (par->lcd_rev == LCD_VERSION_2) {
+            lcdc_write(par, LCD_V2_DMA_CLK_EN | LCD_V2_LIDD_CLK_EN |
                     LCD_V2_CORE_CLK_EN, LCD_CLK_ENABLE_REG);
         }
     } else {
@@ -1034,24 +1364,24 @@ static int lcd_init(struct lcdc_fb_data *par,
     }
 
     //if (panel->sync & FB_SYNC_CLK_INVERT) {
-    //    lcdc_write((lcdc_read(LCD_RASTER_TIMING_2_REG) |
+    //    lcdc_write(par, (lcdc_read(par, LCD_RASTER_TIMING_2_REG) |
     //                LCD_INVERT_PIXEL_CLOCK), LCD_RASTER_TIMING_2_REG);
     //} else {
-    lcdc_write((lcdc_read(LCD_RASTER_TIMING_2_REG) &
+    lcdc_write(par, (lcdc_read(par, LCD_RASTER_TIMING_2_REG) &
                 ~LCD_INVERT_PIXEL_CLOCK), LCD_RASTER_TIMING_2_REG);
     //}
 
-    ret = lcd_cfg_dma(cfg->dma_burst_sz, cfg->fifo_th);
+    ret = lcd_cfg_dma(par, cfg->dma_burst_sz, cfg->fifo_th);
     if (ret < 0) {
         return ret;
     }
 
-    lcd_cfg_vertical_sync(panel->upper_margin, panel->vsync_len,
+    lcd_cfg_vertical_sync(par, panel->upper_margin, panel->vsync_len,
             panel->lower_margin);
-    lcd_cfg_horizontal_sync(panel->left_margin, panel->hsync_len,
+    lcd_cfg_horizontal_sync(par, panel->left_margin, panel->hsync_len,
             panel->right_margin);
 
-    ret = lcd_cfg_display(cfg, panel);
+    ret = lcd_cfg_display(par, cfg, panel);
     if (ret < 0)
         return ret;
 
@@ -1067,7 +1397,7 @@ static int lcd_init(struct lcdc_fb_data *par,
 
     lcdc_load_palette(par);
 
-    lcdc_write((lcdc_read(LCD_RASTER_CTRL_REG) & 0xfff00fff) |
+    lcdc_write(par, (lcdc_read(par, LCD_RASTER_CTRL_REG) & 0xfff00fff) |
             (cfg->fdd << 12), LCD_RASTER_CTRL_REG);
 
     return 0;
@@ -1075,125 +1405,327 @@ static int lcd_init(struct lcdc_fb_data *par,
 
 int register_vsync_cb(vsync_callback_t handler, void *arg, int idx)
 {
-    if ((vsync_cb_handler == NULL) && (vsync_cb_arg == NULL)) {
-        vsync_cb_arg = arg;
-        vsync_cb_handler = handler;
+    struct lcdc_fb_data *par;
+    int ret = 0;
+
+    if (idx < 0 || idx >= LCDC_MAX_INSTANCES) {
+        return -EINVAL;
+    }
+
+    mutex_lock(&lcdc_instances_lock);
+
+    par = lcdc_instances[idx];
+    if (par == NULL) {
+        ret = -ENODEV;
+    } else if ((par->vsync_cb_handler == NULL) && (par->vsync_cb_arg == NULL)) {
+        par->vsync_cb_arg = arg;
+        par->vsync_cb_handler = handler;
     } else {
-        return -EEXIST;
+        ret = -EEXIST;
     }
 
-    return 0;
+    mutex_unlock(&lcdc_instances_lock);
+
+    return ret;
 }
 EXPORT_SYMBOL(register_vsync_cb);
 
 int unregister_vsync_cb(vsync_callback_t handler, void *arg, int idx)
 {
-    if ((vsync_cb_handler == handler) && (vsync_cb_arg == arg)) {
-        vsync_cb_handler = NULL;
-        vsync_cb_arg = NULL;
+    struct lcdc_fb_data *par;
+    int ret = 0;
+
+    if (idx < 0 || idx >= LCDC_MAX_INSTANCES) {
+        return -EINVAL;
+    }
+
+    mutex_lock(&lcdc_instances_lock);
+
+    par = lcdc_instances[idx];
+    if (par && (par->vsync_cb_handler == handler) && (par->vsync_cb_arg == arg)) {
+        par->vsync_cb_handler = NULL;
+        par->vsync_cb_arg = NULL;
     } else {
-        return -ENXIO;
+        ret = -ENXIO;
     }
 
-    return 0;
+    mutex_unlock(&lcdc_instances_lock);
+
+    return ret;
 }
 EXPORT_SYMBOL(unregister_vsync_cb);
 
+/*
+ * curtain_state is only ever touched under curtain_lock, curtain_i2c_lock
+ * just keeps the I2C transfers from interleaving
+ */
+static int lcdc_curtain_get_state(struct lcdc_fb_data *par)
+{
+    unsigned long irq_flags;
+    int state;
+
+    spin_lock_irqsave(&par->curtain_lock, irq_flags);
+    state = par->curtain_state;
+    spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+
+    return state;
+}
+
+static void lcdc_curtain_set_state(struct lcdc_fb_data *par, int state)
+{
+    unsigned long irq_flags;
+
+    spin_lock_irqsave(&par->curtain_lock, irq_flags);
+    par->curtain_state = state;
+    spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+}
+
+static int lcdc_curtain_write(struct lcdc_fb_data *par, int on)
+{
+    int ret = 0;
+
+    mutex_lock(&par->curtain_i2c_lock);
+
+    if (lcdc_curtain_get_state(par) != on) {
+        ret = on ? ti_i2c_curtain_on(par->dlpc) : ti_i2c_curtain_off(par->dlpc);
+        lcdc_curtain_set_state(par, (ret < 0) ? -1 : on);
+    }
+
+    mutex_unlock(&par->curtain_i2c_lock);
+
+    return ret;
+}
+
+static void lcdc_curtain_work(struct work_struct *work)
+{
+    struct lcdc_fb_data *par = container_of(work, struct lcdc_fb_data,
+            curtain_work);
+    unsigned long irq_flags;
+    int target;
+    int ret;
+
+    spin_lock_irqsave(&par->curtain_lock, irq_flags);
+    target = par->curtain_target;
+    spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+
+    ret = lcdc_curtain_write(par, target);
+    if (ret < 0) {
+        dev_err(par->dev, "async curtain %s failed\n", target ? "on" : "off");
+    }
+
+    spin_lock_irqsave(&par->curtain_lock, irq_flags);
+    par->curtain_done_ns = ktime_get_ns();
+
+    /* A request that came in during the write, apply it on the next vsync */
+    if (ret >= 0 && par->curtain_target != par->curtain_state) {
+        if (lcdc_is_raster_enabled(par)) {
+            par->curtain_vsyncs_left = 1;
+            spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+        } else {
+            par->curtain_vsync_ns = ktime_get_ns();
+            spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+            queue_work(system_highpri_wq, &par->curtain_work);
+        }
+        return;
+    }
+
+    par->curtain_busy = false;
+    spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+
+    wake_up_interruptible(&par->curtain_wait);
+}
+
+/* Called from the end of frame interrupt */
+static void lcdc_curtain_vsync(struct lcdc_fb_data *par)
+{
+    spin_lock(&par->curtain_lock);
+
+    if (par->curtain_vsyncs_left > 0 && --par->curtain_vsyncs_left == 0) {
+        par->curtain_vsync_ns = ktime_get_ns();
+        queue_work(system_highpri_wq, &par->curtain_work);
+    }
+
+    spin_unlock(&par->curtain_lock);
+}
+
+static int lcdc_curtain_async(struct lcdc_fb_data *par,
+        const struct lcd_curtain_req *req)
+{
+    unsigned long irq_flags;
+    bool issue_now;
+    int on = req->on ? 1 : 0;
+
+    spin_lock_irqsave(&par->curtain_lock, irq_flags);
+
+    if (!par->curtain_busy && par->curtain_state == on) {
+        spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+        return 0;
+    }
+
+    par->curtain_target = on;
+
+    if (par->curtain_busy) {
+        /* Latest request wins, keep the already chosen vsync */
+        spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+        return 0;
+    }
+
+    par->curtain_busy = true;
+
+    /* Without a running raster no vsync will come */
+    issue_now = !lcdc_is_raster_enabled(par);
+    if (issue_now) {
+        par->curtain_vsyncs_left = 0;
+        par->curtain_vsync_ns = ktime_get_ns();
+    } else {
+        par->curtain_vsyncs_left = max_t(unsigned int, req->vsync_count, 1);
+    }
+
+    spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+
+    if (issue_now) {
+        queue_work(system_highpri_wq, &par->curtain_work);
+    }
+
+    return 0;
+}
+
+static int lcdc_curtain_wait(struct lcdc_fb_data *par,
+        struct lcd_curtain_done *done)
+{
+    unsigned long irq_flags;
+    int ret;
+
+    ret = wait_event_interruptible_timeout(par->curtain_wait,
+            !par->curtain_busy,
+            par->vsync_timeout * (1 + LCD_CURTAIN_MAX_VSYNCS));
+
+    if (ret < 0) {
+        return ret;
+    } else if (ret == 0) {
+        return -ETIMEDOUT;
+    }
+
+    spin_lock_irqsave(&par->curtain_lock, irq_flags);
+    done->on = par->curtain_state;
+    done->vsync_ns = par->curtain_vsync_ns;
+    done->done_ns = par->curtain_done_ns;
+    spin_unlock_irqrestore(&par->curtain_lock, irq_flags);
+
+    return 0;
+}
+
 static irqreturn_t lcdc_irq_handler_rev02(int irq, void *arg)
 {
     struct lcdc_fb_data *par = arg;
-    u32 stat =lcdc_read(LCD_MASKED_STAT_REG);
+    u32 stat =lcdc_read(par, LCD_MASKED_STAT_REG);
+
+    if (stat & LCD_FIFO_UNDERFLOW) {
+        atomic_inc(&par->underflow_count);
+    }
 
     if ((stat & LCD_SYNC_LOST) && (stat & LCD_FIFO_UNDERFLOW)) {
-        lcdc_disable_raster(LCDC_FRAME_NOWAIT);
-        lcdc_write(stat, LCD_MASKED_STAT_REG);
-        lcdc_enable_raster();
+        lcdc_disable_raster(par, LCDC_FRAME_NOWAIT);
+        lcdc_write(par, stat, LCD_MASKED_STAT_REG);
+        lcdc_enable_raster(par);
     } else if (stat & LCD_PL_LOAD_DONE) {
-        lcdc_disable_raster(LCDC_FRAME_NOWAIT);
-        lcdc_write(stat, LCD_MASKED_STAT_REG);
+        lcdc_disable_raster(par, LCDC_FRAME_NOWAIT);
+        lcdc_write(par, stat, LCD_MASKED_STAT_REG);
 
-        lcdc_write(LCD_V2_PL_INT_ENA, LCD_INT_ENABLE_CLR_REG);
+        lcdc_write(par, LCD_V2_PL_INT_ENA, LCD_INT_ENABLE_CLR_REG);
         par->palette_loaded_flag = 1;
 
         wake_up_interruptible(&par->palette_wait);
-        lcdc_enable_raster();
+        lcdc_blit(par, LOAD_DATA);
     } else {
-        lcdc_write(stat, LCD_MASKED_STAT_REG);
+        lcdc_write(par, stat, LCD_MASKED_STAT_REG);
 
         if (stat & LCD_END_OF_FRAME0) {
             par->which_dma_channel_done = 0;
-            lcdc_write(par->dma_start,
+            lcdc_write(par, par->dma_start,
                     LCD_DMA_FRM_BUF_BASE_ADDR_0_REG);
-            lcdc_write(par->dma_end,
+            lcdc_write(par, par->dma_end,
                     LCD_DMA_FRM_BUF_CEILING_ADDR_0_REG);
             par->vsync_flag = 1;
+            atomic_inc(&par->frame_count);
+            lcdc_curtain_vsync(par);
 
             wake_up_interruptible(&par->vsync_wait);
-            if (vsync_cb_handler) {
-                vsync_cb_handler(vsync_cb_arg);
+            if (par->vsync_cb_handler) {
+                par->vsync_cb_handler(par->vsync_cb_arg);
             }
         }
 
         if (stat & LCD_END_OF_FRAME1) {
             par->which_dma_channel_done = 1;
-            lcdc_write(par->dma_start,
+            lcdc_write(par, par->dma_start,
                     LCD_DMA_FRM_BUF_BASE_ADDR_1_REG);
-            lcdc_write(par->dma_end,
+            lcdc_write(par, par->dma_end,
                     LCD_DMA_FRM_BUF_CEILING_ADDR_1_REG);
             par->vsync_flag = 1;
+            atomic_inc(&par->frame_count);
+            lcdc_curtain_vsync(par);
 
             wake_up_interruptible(&par->vsync_wait);
-            if (vsync_cb_handler) {
-                vsync_cb_handler(vsync_cb_arg);
+            if (par->vsync_cb_handler) {
+                par->vsync_cb_handler(par->vsync_cb_arg);
             }
         }
 
         if (stat & BIT(0)) {
-            frame_done_flag = 1;
-            wake_up_interruptible(&frame_done_wq);
+            par->frame_done_flag = 1;
+            wake_up_interruptible(&par->frame_done_wq);
         }
     }
 
-    lcdc_write(0, LCD_END_OF_INT_IND_REG);
+    lcdc_write(par, 0, LCD_END_OF_INT_IND_REG);
     return IRQ_HANDLED;
 }
 
 static irqreturn_t lcdc_irq_handler_rev01(int irq, void *arg)
 {
     struct lcdc_fb_data *par = arg;
-    u32 stat = lcdc_read(LCD_STAT_REG);
+    u32 stat = lcdc_read(par, LCD_STAT_REG);
     u32 reg_ras;
 
+    if (stat & LCD_FIFO_UNDERFLOW) {
+        atomic_inc(&par->underflow_count);
+    }
+
     if ((stat & LCD_SYNC_LOST) && (stat & LCD_FIFO_UNDERFLOW)) {
-        lcdc_disable_raster(LCDC_FRAME_NOWAIT);
+        lcdc_disable_raster(par, LCDC_FRAME_NOWAIT);
 
-        lcdc_write(stat, LCD_STAT_REG);
+        lcdc_write(par, stat, LCD_STAT_REG);
 
-        reg_ras  = lcdc_read(LCD_RASTER_CTRL_REG);
+        reg_ras  = lcdc_read(par, LCD_RASTER_CTRL_REG);
         reg_ras &= ~LCD_V1_PL_INT_ENA;
-        lcdc_write(reg_ras, LCD_RASTER_CTRL_REG);
+        lcdc_write(par, reg_ras, LCD_RASTER_CTRL_REG);
 
         par->palette_loaded_flag = 1;
         wake_up_interruptible(&par->palette_wait);
     } else {
-        lcdc_write(stat, LCD_STAT_REG);
+        lcdc_write(par, stat, LCD_STAT_REG);
         if (stat & LCD_END_OF_FRAME0) {
             par->which_dma_channel_done = 0;
-            lcdc_write(par->dma_start,
+            lcdc_write(par, par->dma_start,
                     LCD_DMA_FRM_BUF_BASE_ADDR_0_REG);
-            lcdc_write(par->dma_end,
+            lcdc_write(par, par->dma_end,
                     LCD_DMA_FRM_BUF_CEILING_ADDR_0_REG);
             par->vsync_flag = 1;
+            atomic_inc(&par->frame_count);
+            lcdc_curtain_vsync(par);
             wake_up_interruptible(&par->vsync_wait);
         }
 
         if (stat & LCD_END_OF_FRAME1) {
             par->which_dma_channel_done = 1;
-            lcdc_write(par->dma_start,
+            lcdc_write(par, par->dma_start,
                     LCD_DMA_FRM_BUF_BASE_ADDR_1_REG);
-            lcdc_write(par->dma_end,
+            lcdc_write(par, par->dma_end,
                     LCD_DMA_FRM_BUF_CEILING_ADDR_1_REG);
             par->vsync_flag = 1;
+            atomic_inc(&par->frame_count);
+            lcdc_curtain_vsync(par);
             wake_up_interruptible(&par->vsync_wait);
         }
     }
@@ -1209,7 +1741,7 @@ static int fb_check_var(struct fb_var_screeninfo *var,
     int bpp = var->bits_per_pixel >> 3;
     unsigned long line_size = var->xres_virtual * bpp;
 
-    if (var->bits_per_pixel > 16 && lcd_rev == LCD_VERSION_1) {
+    if (var->bits_per_pixel > 16 && par->lcd_rev == LCD_VERSION_1) {
         return -EINVAL;
     }
 
@@ -1304,6 +1836,34 @@ static int fb_check_var(struct fb_var_screeninfo *var,
     return err;
 }
 
+/*
+ * Stops everything that can queue the works before cancelling them: the fb
+ * first so no ioctl comes in, then sysfs, the raster and its IRQs
+ */
+static void lcdc_teardown(struct fb_info *info)
+{
+    struct lcdc_fb_data *par = info->par;
+
+    unregister_framebuffer(info);
+
+    mutex_lock(&par->dma_cfg_lock);
+    par->removing = true;
+    par->dma_autotune = false;
+    mutex_unlock(&par->dma_cfg_lock);
+
+    lcdc_disable_raster(par, LCDC_FRAME_WAIT);
+    lcdc_write(par, 0, LCD_RASTER_CTRL_REG);
+
+    if (par->lcd_rev == LCD_VERSION_2) {
+        lcdc_write(par, lcdc_read(par, LCD_INT_ENABLE_SET_REG),
+                LCD_INT_ENABLE_CLR_REG);
+    }
+    synchronize_irq(par->irq);
+
+    cancel_delayed_work_sync(&par->dma_tune_work);
+    cancel_work_sync(&par->curtain_work);
+}
+
 static int fb_remove(struct platform_device *dev)
 {
     struct fb_info *info = dev_get_drvdata(&dev->dev);
@@ -1311,17 +1871,21 @@ static int fb_remove(struct platform_device *dev)
     if (info) {
         struct lcdc_fb_data *par = info->par;
 
+        lcdc_teardown(info);
+
         if (par->panel_power_ctrl) {
             par->panel_power_ctrl(0);
         }
 
-        lcdc_disable_raster(LCDC_FRAME_WAIT);
-        lcdc_write(0, LCD_RASTER_CTRL_REG);
+        mutex_lock(&lcdc_instances_lock);
+        lcdc_instances[par->instance] = NULL;
+        mutex_unlock(&lcdc_instances_lock);
+
+        dlpc_release(par->dlpc);
 
-        unregister_framebuffer(info);
         fb_dealloc_cmap(&info->cmap);
 
-        dma_free_coherent(NULL, PALETTE_SIZE, 
+        dma_free_coherent(NULL, PALETTE_BYTES, 
                 par->v_palette_base, par->p_palette_base);
         dma_free_coherent(NULL, par->vram_size, 
                 par->vram_virt, par->vram_phys);
@@ -1356,7 +1920,11 @@ static int fb_wait_for_vsync(struct fb_info *info)
 static int fb_ioctl(struct fb_info *info, unsigned int cmd,
         unsigned long arg)
 {
+    struct lcdc_fb_data *par = info->par;
     struct lcd_sync_arg sync_arg;
+    struct lcd_curtain_req curtain_req;
+    struct lcd_curtain_done curtain_done;
+    int ret;
 
     DEBUG_PRINTF("[IOCTL]: Got %x Argument\n", cmd);
 
@@ -1374,7 +1942,7 @@ static int fb_ioctl(struct fb_info *info, unsigned int cmd,
                 return -EFAULT;
             }
 
-            lcd_cfg_horizontal_sync(sync_arg.back_porch,
+            lcd_cfg_horizontal_sync(par, sync_arg.back_porch,
                     sync_arg.pulse_width,
                     sync_arg.front_porch);
             break;
@@ -1384,7 +1952,7 @@ static int fb_ioctl(struct fb_info *info, unsigned int cmd,
                 return -EFAULT;
             }
 
-            lcd_cfg_vertical_sync(sync_arg.back_porch,
+            lcd_cfg_vertical_sync(par, sync_arg.back_porch,
                     sync_arg.pulse_width,
                     sync_arg.front_porch);
             break;
@@ -1392,19 +1960,54 @@ static int fb_ioctl(struct fb_info *info, unsigned int cmd,
             return fb_wait_for_vsync(info);
         case FB_BLACKOUT:
             DEBUG_PRINTF("Got FB_BLACKOUT\n");
-            return ti_i2c_curtain_on();
+            return lcdc_curtain_write(par, 1);
         case FB_RESTORE:
             DEBUG_PRINTF("Got FB_RESTORE\n");
-            return ti_i2c_curtain_off();
+            return lcdc_curtain_write(par, 0);
+        case FB_CURTAIN_ASYNC:
+            if (copy_from_user(&curtain_req, (void __user *)arg,
+                        sizeof(struct lcd_curtain_req))) {
+                return -EFAULT;
+            }
+
+            if (curtain_req.vsync_count > LCD_CURTAIN_MAX_VSYNCS) {
+                return -EINVAL;
+            }
+
+            return lcdc_curtain_async(par, &curtain_req);
+        case FB_CURTAIN_WAIT:
+            ret = lcdc_curtain_wait(par, &curtain_done);
+            if (ret < 0) {
+                return ret;
+            }
+
+            if (copy_to_user((void __user *)arg, &curtain_done,
+                        sizeof(struct lcd_curtain_done))) {
+                return -EFAULT;
+            }
+            break;
         case FB_OFF:
             DEBUG_PRINTF("Got FB_OFF\n");
-            return ti_i2c_off();
+            mutex_lock(&par->curtain_i2c_lock);
+            lcdc_curtain_set_state(par, -1);
+            ret = ti_i2c_off(par->dlpc);
+            mutex_unlock(&par->curtain_i2c_lock);
+            return ret;
         case FB_ON:
             DEBUG_PRINTF("Got FB_ON\n");
-            return ti_i2c_on();
+            // init_dev_i2c() leaves the curtain closed
+            mutex_lock(&par->curtain_i2c_lock);
+            ret = ti_i2c_on(par->dlpc);
+            lcdc_curtain_set_state(par, ret ? -1 : 1);
+            mutex_unlock(&par->curtain_i2c_lock);
+            return ret;
         case FB_RESET:
             DEBUG_PRINTF("Got FB_RESET\n");
-            return ti_i2c_reset();
+            mutex_lock(&par->curtain_i2c_lock);
+            ret = ti_i2c_reset(par->dlpc);
+            lcdc_curtain_set_state(par, ret ? -1 : 1);
+            mutex_unlock(&par->curtain_i2c_lock);
+            return ret;
         default:
             DEBUG_PRINTF("Got random shit, -EINVAL\n");
             return -EINVAL;
@@ -1427,7 +2030,7 @@ static int cfb_blank(int blank, struct fb_info *info)
 
     switch (blank) {
         case FB_BLANK_UNBLANK:
-            lcdc_enable_raster();
+            lcdc_enable_raster(par);
 
             if (par->panel_power_ctrl) {
                 par->panel_power_ctrl(1);
@@ -1441,7 +2044,7 @@ static int cfb_blank(int blank, struct fb_info *info)
                 par->panel_power_ctrl(0);
             }
 
-            lcdc_disable_raster(LCDC_FRAME_WAIT);
+            lcdc_disable_raster(par, LCDC_FRAME_WAIT);
             break;
         default:
             ret = -EINVAL;
@@ -1484,14 +2087,14 @@ static int lcdc_pan_display(struct fb_var_screeninfo *var,
                     irq_flags);
 
             if (par->which_dma_channel_done == 0) {
-                lcdc_write(par->dma_start,
+                lcdc_write(par, par->dma_start,
                         LCD_DMA_FRM_BUF_BASE_ADDR_0_REG);
-                lcdc_write(par->dma_end,
+                lcdc_write(par, par->dma_end,
                         LCD_DMA_FRM_BUF_CEILING_ADDR_0_REG);
             } else if (par->which_dma_channel_done == 1) {
-                lcdc_write(par->dma_start,
+                lcdc_write(par, par->dma_start,
                         LCD_DMA_FRM_BUF_BASE_ADDR_1_REG);
-                lcdc_write(par->dma_end,
+                lcdc_write(par, par->dma_end,
                         LCD_DMA_FRM_BUF_CEILING_ADDR_1_REG);
             }
 
@@ -1507,22 +2110,31 @@ static int lcdc_set_par(struct fb_info *info)
 {
     struct lcdc_fb_data *par = info->par;
     int ret;
-    bool raster = lcdc_is_raster_enabled();
+    bool raster = lcdc_is_raster_enabled(par);
 
     if (raster) {
-        lcdc_disable_raster(LCDC_FRAME_WAIT);
+        lcdc_disable_raster(par, LCDC_FRAME_WAIT);
     }
 
     fb_var_to_videomode(&par->mode, &info->var);
 
-    lcdc_fb_var.pixclock = 15000000; // TODO change this to read from devicetree
-
     par->cfg.bpp = info->var.bits_per_pixel;
 
     info->fix.visual = (par->cfg.bpp <= 8) ?
         FB_VISUAL_PSEUDOCOLOR : FB_VISUAL_TRUECOLOR;
     info->fix.line_length = (par->mode.xres * par->cfg.bpp) / 8;
 
+    // Needed by the palette load in lcd_init() already
+    par->dma_start = info->fix.smem_start +
+        info->var.yoffset * info->fix.line_length +
+        info->var.xoffset * info->var.bits_per_pixel / 8;
+    par->dma_end   = par->dma_start + 
+        info->var.yres * info->fix.line_length - 1;
+
+    if (par->cfg.bpp == 8) {
+        lcdc_fill_mono_palette(par);
+    }
+
     ret = lcd_init(par, &par->cfg, &par->mode);
 
     if (ret < 0) {
@@ -1530,24 +2142,208 @@ static int lcdc_set_par(struct fb_info *info)
         return ret;
     }
 
-    par->dma_start = info->fix.smem_start +
-        info->var.yoffset * info->fix.line_length +
-        info->var.xoffset * info->var.bits_per_pixel / 8;
-    par->dma_end   = par->dma_start + 
-        info->var.yres * info->fix.line_length - 1;
-
-    lcdc_write(par->dma_start, LCD_DMA_FRM_BUF_BASE_ADDR_0_REG);
-    lcdc_write(par->dma_end, LCD_DMA_FRM_BUF_CEILING_ADDR_0_REG);
-    lcdc_write(par->dma_start, LCD_DMA_FRM_BUF_BASE_ADDR_1_REG);
-    lcdc_write(par->dma_end, LCD_DMA_FRM_BUF_CEILING_ADDR_1_REG);
+    lcdc_write(par, par->dma_start, LCD_DMA_FRM_BUF_BASE_ADDR_0_REG);
+    lcdc_write(par, par->dma_end, LCD_DMA_FRM_BUF_CEILING_ADDR_0_REG);
+    lcdc_write(par, par->dma_start, LCD_DMA_FRM_BUF_BASE_ADDR_1_REG);
+    lcdc_write(par, par->dma_end, LCD_DMA_FRM_BUF_CEILING_ADDR_1_REG);
 
     if (raster) {
-        lcdc_enable_raster();
+        lcdc_enable_raster(par);
     }
 
     return 0;
 }
 
+static struct lcdc_fb_data *dev_to_lcdc_par(struct device *dev)
+{
+    struct fb_info *info = dev_get_drvdata(dev);
+
+    return info->par;
+}
+
+static ssize_t dma_burst_sz_show(struct device *dev,
+        struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%d\n", dev_to_lcdc_par(dev)->cfg.dma_burst_sz);
+}
+
+static ssize_t dma_burst_sz_store(struct device *dev,
+        struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct lcdc_fb_data *par = dev_to_lcdc_par(dev);
+    int val;
+
+    if (kstrtoint(buf, 0, &val)) {
+        return -EINVAL;
+    }
+
+    switch (val) {
+        case 1:
+        case 2:
+        case 4:
+        case 8:
+        case 16:
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    lcdc_apply_dma_cfg(par, val, par->cfg.fifo_th);
+
+    return count;
+}
+static DEVICE_ATTR_RW(dma_burst_sz);
+
+static ssize_t fifo_th_show(struct device *dev,
+        struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%d\n", dev_to_lcdc_par(dev)->cfg.fifo_th);
+}
+
+static ssize_t fifo_th_store(struct device *dev,
+        struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct lcdc_fb_data *par = dev_to_lcdc_par(dev);
+    int val;
+
+    if (kstrtoint(buf, 0, &val) || val < 0 || val > LCD_DMA_FIFO_TH_MAX) {
+        return -EINVAL;
+    }
+
+    lcdc_apply_dma_cfg(par, par->cfg.dma_burst_sz, val);
+
+    return count;
+}
+static DEVICE_ATTR_RW(fifo_th);
+
+static ssize_t dma_autotune_show(struct device *dev,
+        struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%d\n", dev_to_lcdc_par(dev)->dma_autotune);
+}
+
+static ssize_t dma_autotune_store(struct device *dev,
+        struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct lcdc_fb_data *par = dev_to_lcdc_par(dev);
+    bool val;
+
+    if (kstrtobool(buf, &val)) {
+        return -EINVAL;
+    }
+
+    mutex_lock(&par->dma_cfg_lock);
+
+    if (par->removing) {
+        mutex_unlock(&par->dma_cfg_lock);
+        return -ENODEV;
+    }
+
+    if (val == par->dma_autotune) {
+        mutex_unlock(&par->dma_cfg_lock);
+        return count;
+    }
+
+    par->dma_autotune = val;
+
+    if (val) {
+        par->dma_tune_last_underflows = atomic_read(&par->underflow_count);
+        par->dma_tune_clean_periods = 0;
+        par->dma_best_burst_sz = 0;
+        par->dma_best_fifo_th = 0;
+        schedule_delayed_work(&par->dma_tune_work,
+                msecs_to_jiffies(DMA_TUNE_PERIOD_MS));
+    }
+
+    mutex_unlock(&par->dma_cfg_lock);
+
+    // The work takes dma_cfg_lock itself
+    if (!val) {
+        cancel_delayed_work_sync(&par->dma_tune_work);
+    }
+
+    return count;
+}
+static DEVICE_ATTR_RW(dma_autotune);
+
+static ssize_t dma_best_show(struct device *dev,
+        struct device_attribute *attr, char *buf)
+{
+    struct lcdc_fb_data *par = dev_to_lcdc_par(dev);
+
+    return sysfs_emit(buf, "%d %d\n", par->dma_best_burst_sz,
+            par->dma_best_fifo_th);
+}
+static DEVICE_ATTR_RO(dma_best);
+
+static ssize_t underflow_count_show(struct device *dev,
+        struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%d\n",
+            atomic_read(&dev_to_lcdc_par(dev)->underflow_count));
+}
+static DEVICE_ATTR_RO(underflow_count);
+
+static ssize_t frame_count_show(struct device *dev,
+        struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%d\n",
+            atomic_read(&dev_to_lcdc_par(dev)->frame_count));
+}
+static DEVICE_ATTR_RO(frame_count);
+
+static ssize_t mono_channels_show(struct device *dev,
+        struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", dev_to_lcdc_par(dev)->mono_channels);
+}
+
+/*
+ * Under the fb lock like fb_set_par() and the cmap ioctls, the palette is
+ * not reloaded under a mode set. In 8bpp the reload restarts the raster,
+ * not something to do during an exposure.
+ */
+static ssize_t mono_channels_store(struct device *dev,
+        struct device_attribute *attr, const char *buf, size_t count)
+{
+    struct fb_info *info = dev_get_drvdata(dev);
+    struct lcdc_fb_data *par = info->par;
+    unsigned int val;
+
+    if (kstrtouint(buf, 0, &val) || val == 0 || (val & ~MONO_CHANNEL_ALL)) {
+        return -EINVAL;
+    }
+
+    lock_fb_info(info);
+
+    par->mono_channels = val;
+
+    if (par->cfg.bpp == 8) {
+        lcdc_fill_mono_palette(par);
+        lcdc_load_palette(par);
+    }
+
+    unlock_fb_info(info);
+
+    return count;
+}
+static DEVICE_ATTR_RW(mono_channels);
+
+static struct attribute *lcdc_attrs[] = {
+    &dev_attr_dma_burst_sz.attr,
+    &dev_attr_fifo_th.attr,
+    &dev_attr_dma_autotune.attr,
+    &dev_attr_dma_best.attr,
+    &dev_attr_underflow_count.attr,
+    &dev_attr_frame_count.attr,
+    &dev_attr_mono_channels.attr,
+    NULL,
+};
+
+static const struct attribute_group lcdc_attr_group = {
+    .attrs = lcdc_attrs,
+};
+
 static struct fb_ops lcdc_fb_ops = {
     .owner          = THIS_MODULE,
     .fb_check_var   = fb_check_var,
@@ -1561,7 +2357,8 @@ static struct fb_ops lcdc_fb_ops = {
     .fb_blank       = cfb_blank,
 };
 
-static struct lcd_ctrl_config *lcdc_fb_create_cfg(struct platform_device *dev)
+static struct lcd_ctrl_config *lcdc_fb_create_cfg(struct platform_device *dev,
+        unsigned int lcd_rev)
 {
     struct lcd_ctrl_config *cfg;
 
@@ -1578,30 +2375,54 @@ static struct lcd_ctrl_config *lcdc_fb_create_cfg(struct platform_device *dev)
     }
 
     cfg->panel_shade = COLOR_ACTIVE;
+    cfg->dma_burst_sz = 16;
+    cfg->fifo_th = 0;
     return cfg;
 }
 
-static int get_gpio(struct platform_device *dev)
+static int get_gpio(struct platform_device *dev, struct dlpc_dev *dlpc, int instance)
 {
-    proj_en = gpio_to_desc(0 + 16);
-    if (!proj_en) {
+    dlpc->proj_en = devm_gpiod_get_optional(&dev->dev, "proj-en", GPIOD_OUT_HIGH);
+    if (IS_ERR(dlpc->proj_en)) {
+        dev_err(&(dev->dev), "Error getting proj-en gpio");
+        return -1;
+    }
+
+    dlpc->proj_rdy = devm_gpiod_get_optional(&dev->dev, "proj-rdy", GPIOD_IN);
+    if (IS_ERR(dlpc->proj_rdy)) {
+        dev_err(&(dev->dev), "Error getting proj-rdy gpio");
+        return -1;
+    }
+
+    if (dlpc->proj_en && dlpc->proj_rdy) {
+        return 0;
+    }
+
+    // Device trees without proj-*-gpios only describe the first board
+    if (instance != 0) {
+        dev_err(&(dev->dev), "proj-en/proj-rdy gpios missing in device tree");
+        return -1;
+    }
+
+    dlpc->proj_en = gpio_to_desc(0 + 16);
+    if (!dlpc->proj_en) {
         dev_err(&(dev->dev), "Error getting pin 16 (PROJ_EN)");
         return -1;
     }
 
-    proj_rdy = gpio_to_desc(0 + 29);
-    if (!proj_rdy) {
+    dlpc->proj_rdy = gpio_to_desc(0 + 29);
+    if (!dlpc->proj_rdy) {
         dev_err(&(dev->dev), "Error getting pin 29 (PROJ_RDY)");
         return -1;
     }
 
-    int status = gpiod_direction_output(proj_en, 1);
+    int status = gpiod_direction_output(dlpc->proj_en, 1);
     if (status) {
         dev_err(&(dev->dev), "Error setting pin 16 (PROJ_EN) as output");
         return -1;
     }
 
-    status = gpiod_direction_input(proj_rdy);
+    status = gpiod_direction_input(dlpc->proj_rdy);
     if (status) {
         dev_err(&(dev->dev), "Error setting pin 29 (PROJ_RDY) as input");
         return -1;
@@ -1652,7 +2473,7 @@ static struct fb_videomode *lcdc_fb_get_videomode(struct platform_device *dev)
 static int fb_probe(struct platform_device *device)
 {
     struct lcdc_platform_data *fb_pdata = device->dev.platform_data;
-    static struct resource *lcdc_regs;
+    struct resource *lcdc_regs;
     struct lcd_ctrl_config *lcd_cfg;
     struct fb_videomode *lcdc_info;
     struct fb_info *lcdc_fb_info;
@@ -1661,6 +2482,14 @@ static int fb_probe(struct platform_device *device)
     int ret;
     unsigned long ulcm;
     struct device_node *hdmi_node = NULL;
+    void __iomem *reg_base;
+    void __iomem *ocp_reg_base;
+    unsigned int lcd_rev;
+    irq_handler_t lcdc_irq_handler;
+    struct fb_var_screeninfo lcdc_fb_var = { 0 };
+    struct fb_fix_screeninfo lcdc_fb_fix = lcdc_fb_fix_default;
+    struct dlpc_dev *dlpc;
+    int instance;
 
     struct pinctrl *pinctrl;
     struct pinctrl_state *default_state;
@@ -1716,18 +2545,20 @@ static int fb_probe(struct platform_device *device)
 
     DEBUG_PRINTF("lcdc_regs: start:%x, size:%x\n", lcdc_regs->start, resource_size(lcdc_regs));
 
-    lcdc_fb_reg_base = devm_ioremap_resource(&device->dev, lcdc_regs);
-    if (IS_ERR(lcdc_fb_reg_base)) {
+    reg_base = devm_ioremap_resource(&device->dev, lcdc_regs);
+    if (IS_ERR(reg_base)) {
         dev_err(&device->dev, "failed to ioremap registers\n");
-        return PTR_ERR(lcdc_fb_reg_base);
+        return PTR_ERR(reg_base);
     }
 
+    // SoC wide OCP priority setting, harmless to repeat for every instance
     ocp_reg_base = ioremap(0x4C000000, 0x1000);
     unsigned int data_ocp = readl(ocp_reg_base + 0x54);
     writel(((data_ocp & 0xFF000000) | 0xFFFF00), ocp_reg_base + 0x54);
+    iounmap(ocp_reg_base);
 
-    DEBUG_PRINTF("lcdc_fb_reg_base @%px (phys 0x%08lx)\n",
-            lcdc_fb_reg_base, (unsigned long)lcdc_regs->start);
+    DEBUG_PRINTF("reg_base @%px (phys 0x%08lx)\n",
+            reg_base, (unsigned long)lcdc_regs->start);
 
     tmp_lcdc_clk = clk_get(&device->dev, "fck");
     if (IS_ERR(tmp_lcdc_clk)) {
@@ -1742,7 +2573,7 @@ static int fb_probe(struct platform_device *device)
     pm_runtime_get_sync(&device->dev);
 
     DEBUG_PRINTF("Bef read\n");
-    unsigned long data = lcdc_read(LCD_PID_REG);
+    unsigned long data = readl(reg_base + LCD_PID_REG);
     DEBUG_PRINTF("Aft read\n");
     switch (data) {
         case 0x4C100102:
@@ -1753,21 +2584,29 @@ static int fb_probe(struct platform_device *device)
             lcd_rev = LCD_VERSION_2;
             break;
         default:
-            dev_warn(&device->dev, "Unknown PID Reg value 0x%x, defaulting to rev 1\n",
-                    lcdc_read(LCD_PID_REG));
+            dev_warn(&device->dev, "Unknown PID Reg value 0x%lx, defaulting to rev 1\n",
+                    data);
             lcd_rev = LCD_VERSION_1;
             break;
     }
     DEBUG_PRINTF("lcd_rev:%x", lcd_rev);
 
     if (device->dev.of_node) {
-        lcd_cfg = lcdc_fb_create_cfg(device);
+        lcd_cfg = lcdc_fb_create_cfg(device, lcd_rev);
     } else {
         lcd_cfg = fb_pdata->controller_data;
     }
 
     if (!lcd_cfg) {
-        return -EINVAL;
+        ret = -EINVAL;
+        goto err_pm_runtime_disable;
+    }
+
+    dlpc = dlpc_claim(device);
+    if (!dlpc) {
+        // dlp_probe() has not seen our projector yet
+        DEBUG_PRINTF("No DLPC available, deferring\n");
+        ret = -EPROBE_DEFER;
         goto err_pm_runtime_disable;
     }
 
@@ -1778,10 +2617,34 @@ static int fb_probe(struct platform_device *device)
     if (!lcdc_fb_info) {
         dev_dbg(&device->dev, "Memory allocation falied for lcdc_fb_info\n");
         ret = -ENOMEM;
-        goto err_pm_runtime_disable;
+        goto err_release_dlpc;
     }
 
     par = lcdc_fb_info->par;
+
+    mutex_lock(&lcdc_instances_lock);
+    for (instance = 0; instance < LCDC_MAX_INSTANCES; instance++) {
+        if (lcdc_instances[instance] == NULL) {
+            lcdc_instances[instance] = par;
+            break;
+        }
+    }
+    mutex_unlock(&lcdc_instances_lock);
+
+    if (instance == LCDC_MAX_INSTANCES) {
+        dev_err(&device->dev, "Too many lcdc instances\n");
+        framebuffer_release(lcdc_fb_info);
+        ret = -EBUSY;
+        goto err_release_dlpc;
+    }
+
+    par->instance = instance;
+    par->reg_base = reg_base;
+    par->lcd_rev = lcd_rev;
+    par->dlpc = dlpc;
+    par->mono_channels = MONO_CHANNEL_ALL;
+    init_waitqueue_head(&par->frame_done_wq);
+
     par->dev = &device->dev;
     par->lcdc_clk = tmp_lcdc_clk;
     par->lcdc_clk_rate = clk_get_rate(par->lcdc_clk);
@@ -1800,7 +2663,7 @@ static int fb_probe(struct platform_device *device)
     fb_videomode_to_var(&lcdc_fb_var, lcdc_info);
     par->cfg = *lcd_cfg;
 
-    lcdc_fb_lcd_reset();
+    lcdc_fb_lcd_reset(par);
 
     par->vram_size = lcdc_info->xres * lcdc_info->yres * lcd_cfg->bpp;
     ulcm = lcm((lcdc_info->xres * lcd_cfg->bpp)/8, PAGE_SIZE);
@@ -1829,7 +2692,7 @@ static int fb_probe(struct platform_device *device)
 
     DEBUG_PRINTF("Start: %X, end: %X\n", par->dma_start, par->dma_end);
 
-    par->v_palette_base         = dma_alloc_coherent(par->dev, PALETTE_SIZE,
+    par->v_palette_base         = dma_alloc_coherent(par->dev, PALETTE_BYTES,
             (resource_size_t *)&par->p_palette_base,
             GFP_KERNEL | GFP_DMA);
 
@@ -1840,7 +2703,7 @@ static int fb_probe(struct platform_device *device)
         goto err_release_fb_mem;
     }
 
-    memset(par->v_palette_base, 0, PALETTE_SIZE);
+    memset(par->v_palette_base, 0, PALETTE_BYTES);
 
     par->irq = platform_get_irq(device, 0);
     if (par->irq < 0) {
@@ -1848,10 +2711,9 @@ static int fb_probe(struct platform_device *device)
         goto err_release_pl_mem;
     }
 
-    if (lcd_rev == LCD_VERSION_1) {
+    if (par->lcd_rev == LCD_VERSION_1) {
         lcdc_irq_handler = lcdc_irq_handler_rev01;
     } else {
-        init_waitqueue_head(&frame_done_wq);
         lcdc_irq_handler = lcdc_irq_handler_rev02;
     }
 
@@ -1889,6 +2751,18 @@ static int fb_probe(struct platform_device *device)
 
     init_waitqueue_head(&par->palette_wait);
 
+    mutex_init(&par->dma_cfg_lock);
+    spin_lock_init(&par->dma_cfg_spin);
+    atomic_set(&par->underflow_count, 0);
+    atomic_set(&par->frame_count, 0);
+    INIT_DELAYED_WORK(&par->dma_tune_work, lcdc_dma_tune_work);
+
+    par->curtain_state = -1;
+    spin_lock_init(&par->curtain_lock);
+    mutex_init(&par->curtain_i2c_lock);
+    INIT_WORK(&par->curtain_work, lcdc_curtain_work);
+    init_waitqueue_head(&par->curtain_wait);
+
     lcdc_fb_var.activate = FB_ACTIVATE_FORCE;
     fb_set_var(lcdc_fb_info, &lcdc_fb_var);
 
@@ -1903,46 +2777,58 @@ static int fb_probe(struct platform_device *device)
             "bpp:%u\n, clock_rate:%u", par->vram_size, par->dma_start, par->dma_end,
             par->cfg.bpp, par->lcdc_clk_rate);
 
-    lcdc_enable_raster();
+    lcdc_enable_raster(par);
 
     DEBUG_PRINTF("Raster enabled\n");
 
-    ret = get_gpio(device);
+    ret = devm_device_add_group(&device->dev, &lcdc_attr_group);
+    if (ret) {
+        dev_warn(&device->dev, "Failed to create sysfs attributes\n");
+    }
+
+    ret = get_gpio(device, dlpc, instance);
     DEBUG_PRINTF("gpio gotten\n");
 
     if (ret) {
-        dev_err(&device->dev, "Failed to get GPIOs, continuing without projector support\n");
-        goto err_dealloc_cmap;
+        dev_err(&device->dev, "Failed to get GPIOs\n");
+        goto err_unregister_fb;
     }
     
-    irq_number = gpio_to_irq(29);
+    dlpc->irq = gpiod_to_irq(dlpc->proj_rdy);
     DEBUG_PRINTF("gpio irq gotten\n");
 
-    ret = request_irq(irq_number, gpio_irq_handler,
+    ret = devm_request_irq(&device->dev, dlpc->irq, gpio_irq_handler,
                           IRQF_TRIGGER_FALLING,
-                          "proj_on_irq", NULL);
+                          "proj_on_irq", dlpc);
+    if (ret) {
+        dev_err(&device->dev, "Failed to request PROJ_RDY irq %d\n", dlpc->irq);
+        goto err_unregister_fb;
+    }
     DEBUG_PRINTF("irq request gotten\n");
 
-    DEBUG_PRINTF("Waiting for i2c init\n");
-    while (wait_for_i2c);
-
-    DEBUG_PRINTF("Bef sleep\n");
-    msleep(300);
-    DEBUG_PRINTF("Aft sleep\n");
+    // PROJ_EN was raised in get_gpio(), so the edge may already be gone and
+    // the level counts; on timeout still try the init, the device ID check
+    // catches a dead DLPC
+    if (ti_wait_proj_rdy(dlpc, true) < 0) {
+        dev_warn(&device->dev, "PROJ_RDY not seen, trying projector init anyway\n");
+    }
 
-    // Now safe to initialize the projector
-    if (init_dev_i2c() < 0) {
+    if (init_dev_i2c(dlpc) < 0) {
         dev_err(&device->dev, "Failed to initialize DLP projector\n");
-        return -EIO;
+        ret = -EIO;
+        goto err_unregister_fb;
     }
 
     return 0;
 
+err_unregister_fb:
+    lcdc_teardown(lcdc_fb_info);
+
 err_dealloc_cmap:
     fb_dealloc_cmap(&lcdc_fb_info->cmap);
 
 err_release_pl_mem:
-    dma_free_coherent(NULL, PALETTE_SIZE, par->v_palette_base,
+    dma_free_coherent(NULL, PALETTE_BYTES, par->v_palette_base,
             par->p_palette_base);
 
 err_release_fb_mem:
@@ -1950,8 +2836,15 @@ err_release_fb_mem:
             par->vram_phys);
 
 err_release_fb:
+    mutex_lock(&lcdc_instances_lock);
+    lcdc_instances[par->instance] = NULL;
+    mutex_unlock(&lcdc_instances_lock);
+
     framebuffer_release(lcdc_fb_info);
 
+err_release_dlpc:
+    dlpc_release(dlpc);
+
 err_pm_runtime_disable:
     pm_runtime_put_sync(&device->dev);
     pm_runtime_disable(&device->dev);
@@ -1969,7 +2862,7 @@ static int fb_resume(struct platform_device *pdev)
     if (par->panel_power_ctrl)
         par->panel_power_ctrl(1);
 
-    lcdc_enable_raster();
+    lcdc_enable_raster(par);
     return 0;
 }
 
@@ -1978,7 +2871,7 @@ static int fb_suspend(struct platform_device *pdev, pm_message_t mes)
     struct fb_info *info = dev_get_drvdata(&pdev->dev);
     struct lcdc_fb_data *par = info->par;
 
-    lcdc_disable_raster(LCDC_FRAME_WAIT);
+    lcdc_disable_raster(par, LCDC_FRAME_WAIT);
     if (par->panel_power_ctrl)
         par->panel_power_ctrl(0);
 
@@ -2006,28 +2899,50 @@ static struct platform_driver lcdc_fb_driver = {
     },
 };
 
-static void __exit lcdc_fb_cleanup(void)
+// Called when a DLPC is found on I2C, fb_probe() then claims it
+static int dlp_probe(struct i2c_client *client, const struct i2c_device_id *id)
 {
-    platform_driver_unregister(&lcdc_fb_driver);
-}
+    struct dlpc_dev *dlpc;
 
-// Add global (or static) pointer
-static struct i2c_client *i2c_client;
+    dlpc = devm_kzalloc(&client->dev, sizeof(*dlpc), GFP_KERNEL);
+    if (!dlpc) {
+        return -ENOMEM;
+    }
 
-// Add this function — this will be called when I2C device is found
-static int dlp_probe(struct i2c_client *client, const struct i2c_device_id *id)
-{
-    i2c_client = client;
-    DEBUG_PRINTF("DLP I2C controller found at 0x%02x\n", client->addr);
+    dlpc->client = client;
+    init_waitqueue_head(&dlpc->event_wait);
+    i2c_set_clientdata(client, dlpc);
 
-    wait_for_i2c = false;
+    mutex_lock(&dlpc_list_lock);
+    list_add_tail(&dlpc->node, &dlpc_list);
+    mutex_unlock(&dlpc_list_lock);
+
+    DEBUG_PRINTF("DLP I2C controller found at 0x%02x\n", client->addr);
 
     return 0;
 }
 
+/*
+ * The dlpc goes with the client, a framebuffer still driving it is unbound
+ * first. Off the list nothing can claim it in the meantime.
+ */
 static void dlp_remove(struct i2c_client *client)
 {
-    i2c_client = NULL;
+    struct dlpc_dev *dlpc = i2c_get_clientdata(client);
+    struct device *owner = NULL;
+
+    mutex_lock(&dlpc_list_lock);
+    list_del(&dlpc->node);
+    if (dlpc->claimed) {
+        owner = get_device(dlpc->owner);
+    }
+    mutex_unlock(&dlpc_list_lock);
+
+    if (owner) {
+        dev_info(&client->dev, "DLPC going away, unbinding %s\n", dev_name(owner));
+        device_release_driver(owner);
+        put_device(owner);
+    }
 }
 
 // I2C driver definition
@@ -2064,6 +2979,12 @@ static int __init lcdc_fb_init(void)
     return platform_driver_register(&lcdc_fb_driver);
 }
 
+static void __exit lcdc_fb_cleanup(void)
+{
+    platform_driver_unregister(&lcdc_fb_driver);
+    i2c_del_driver(&dlp_i2c_driver);
+}
+
 module_init(lcdc_fb_init);
 module_exit(lcdc_fb_cleanup);
 
@@ -1,8 +1,13 @@
+#ifndef LCDC_DRV_H
+#define LCDC_DRV_H
+
 #define LCD_REGISTERS_ADDR 0x4830E000
 #define LCD_CLEAR_IRQ      0x5C
 #define LCD_READ_IRQ       0x58
 #define LCD_REGISTERS_SIZE 0x1000
 
+#define EVM2000_PROJ_ON_TIMEOUT_S 2
+
 #define LCD_WRITE _IOW('k', 1, struct lcd_ioctl_data)
 #define LCD_READ  _IOR('k', 2, struct lcd_ioctl_data)
 #define FBIGET_BRIGHTNESS   _IOR('F', 3, int)
@@ -18,8 +23,27 @@
 #define FB_RESET        _IO('F', 15)
 #define FBIOGET_CONTRAST    _IOR('F', 16, int)
 #define FBIOPUT_CONTRAST    _IOW('F', 17, int)
+#define FB_CURTAIN_ASYNC    _IOW('F', 18, struct lcd_curtain_req)
+#define FB_CURTAIN_WAIT     _IOR('F', 19, struct lcd_curtain_done)
+
+#define LCD_CURTAIN_MAX_VSYNCS  16
 
 struct lcd_ioctl_data {
     unsigned int address;
     unsigned int data;
 };
+
+/* Curtain change issued from a workqueue after vsync_count (>= 1) vsyncs */
+struct lcd_curtain_req {
+    unsigned int on;
+    unsigned int vsync_count;
+};
+
+/* CLOCK_MONOTONIC times of the aligning vsync and of the finished I2C write */
+struct lcd_curtain_done {
+    int on;
+    unsigned long long vsync_ns;
+    unsigned long long done_ns;
+};
+
+#endif /* LCDC_DRV_H */
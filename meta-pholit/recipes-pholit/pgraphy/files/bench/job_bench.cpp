@@ -0,0 +1,418 @@
+/*
+ * End-to-end job throughput benchmark.
+ *
+ * Runs the whole pgraphy flow on synthetic masks against table_emu and the
+ * mem sink with all table/settle/exposure waits scaled down, then projects
+ * the traced phases back to real time to report tiles/hour, a per-phase
+ * breakdown and peak RSS.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <argp.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include <string>
+#include <vector>
+
+#include "masks.hpp"
+
+struct arguments {
+    char *pgraphy;
+    char *emu;
+    char *work_dir;
+    char *json;
+    double scale;
+    int time;
+    bool mono;
+    bool verbose;
+};
+
+struct job_res {
+    int width, height;
+};
+
+static const struct job_res job_sizes[] = {
+    { 640, 360 },
+    { 1920, 1080 },
+    { 3840, 2160 },
+};
+
+#define N_JOB_SIZES     (sizeof(job_sizes)/sizeof(job_sizes[0]))
+
+enum job_phase {
+    PH_INIT,
+    PH_READ_IMG,
+    PH_HOMING,
+    PH_MOVE,
+    PH_SETTLE,
+    PH_PREPARE,
+    PH_UPLOAD,
+    PH_EXPOSE,
+    PH_BLANK,
+    PH_DEINIT,
+    PH_COUNT,
+};
+
+struct phase_desc {
+    const char *name;
+    bool scaled;    // a wait that --time-scale / table_emu -s shrink
+};
+
+// Names match the TRACE_SCOPE spans in main.cpp
+static const struct phase_desc phases[PH_COUNT] = {
+    { "init",       false },
+    { "read_img",   false },
+    { "homing",     true },
+    { "move",       true },
+    { "settle",     true },
+    { "prepare",    false },
+    { "upload",     false },
+    { "expose",     true },
+    { "blank",      false },
+    { "deinit",     false },
+};
+
+struct job_result {
+    enum mask_kind kind;
+    int width, height;
+
+    int tiles;
+    double wall_s;
+    double real_s;
+    double phase_s[PH_COUNT];
+    long peak_rss_kb;
+};
+
+struct arguments args;
+
+    static double
+now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+    static pid_t
+spawn(char *const argv[], bool quiet)
+{
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        if (quiet) {
+            int fd = open("/dev/null", O_WRONLY);
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+        }
+
+        execv(argv[0], argv);
+        perror("execv:");
+        _exit(127);
+    }
+
+    return pid;
+}
+
+    static int
+wait_for_file(const char *path, int timeout_ms)
+{
+    struct stat st;
+
+    for (int i = 0; i < timeout_ms / 10; i++) {
+        if (stat(path, &st) == 0) {
+            return 0;
+        }
+        usleep(10000);
+    }
+
+    return -1;
+}
+
+    static int
+parse_trace(const char *path, struct job_result *res)
+{
+    FILE *f = fopen(path, "r");
+    char line[512];
+
+    if (f == NULL) {
+        perror("trace:");
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char name[64];
+        double ts, dur;
+
+        if (sscanf(line, "{\"name\":\"%63[^\"]\",\"ph\":\"X\",\"pid\":%*d,\"tid\":%*d,"
+                   "\"ts\":%lf,\"dur\":%lf", name, &ts, &dur) != 3) {
+            continue;
+        }
+
+        if (strcmp(name, "tile") == 0) {
+            res->tiles++;
+            continue;
+        }
+
+        for (int p = 0; p < PH_COUNT; p++) {
+            if (strcmp(name, phases[p].name) == 0) {
+                res->phase_s[p] += dur / 1e6;
+                break;
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 0;
+}
+
+    static int
+run_job(enum mask_kind kind, int width, int height, struct job_result *res)
+{
+    std::string base = std::string(args.work_dir) + "/" + mask_kind_name(kind) + "_" +
+        std::to_string(width) + "x" + std::to_string(height);
+    std::string mask = base + ".png";
+    std::string trace = base + ".trace.json";
+    std::string tty = std::string(args.work_dir) + "/ttyEMU";
+    std::string scale = std::to_string(args.scale);
+    std::string time = std::to_string(args.time);
+    struct rusage ru;
+    int status;
+
+    memset(res, 0, sizeof(*res));
+    memset(&ru, 0, sizeof(ru));
+    res->kind = kind;
+    res->width = width;
+    res->height = height;
+
+    if (!cv::imwrite(mask, make_mask(kind, width, height))) {
+        fprintf(stderr, "cv::imwrite %s failed\n", mask.c_str());
+        return -1;
+    }
+
+    char *emu_argv[] = {
+        args.emu, (char *)"-s", (char *)scale.c_str(), (char *)"-l", (char *)tty.c_str(),
+        NULL,
+    };
+
+    unlink(tty.c_str());
+    pid_t emu = spawn(emu_argv, true);
+
+    if (emu == -1 || wait_for_file(tty.c_str(), 2000) != 0) {
+        fprintf(stderr, "table_emu did not come up\n");
+        if (emu > 0) {
+            kill(emu, SIGTERM);
+            waitpid(emu, NULL, 0);
+        }
+        return -1;
+    }
+
+    std::vector<char *> pg_argv = {
+        args.pgraphy,
+        (char *)"-f", (char *)mask.c_str(),
+        (char *)"-p", (char *)tty.c_str(),
+        (char *)"-s", (char *)"mem",
+        (char *)"-S", (char *)scale.c_str(),
+        (char *)"-t", (char *)time.c_str(),
+        (char *)"-T", (char *)trace.c_str(),
+    };
+
+    if (args.mono) {
+        pg_argv.push_back((char *)"-m");
+    }
+    pg_argv.push_back(NULL);
+
+    double start = now_s();
+    pid_t pg = spawn(pg_argv.data(), !args.verbose);
+
+    if (pg == -1 || wait4(pg, &status, 0, &ru) == -1) {
+        perror("pgraphy:");
+        status = -1;
+    }
+
+    res->wall_s = now_s() - start;
+    res->peak_rss_kb = ru.ru_maxrss;
+
+    kill(emu, SIGTERM);
+    waitpid(emu, NULL, 0);
+
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "pgraphy failed on %s\n", mask.c_str());
+        return -1;
+    }
+
+    if (parse_trace(trace.c_str(), res) != 0) {
+        return -1;
+    }
+
+    // Undo the scaling of the waits, everything else already ran at full speed
+    res->real_s = res->wall_s;
+    for (int p = 0; p < PH_COUNT; p++) {
+        if (phases[p].scaled) {
+            res->phase_s[p] /= args.scale;
+            res->real_s += res->phase_s[p] * (1.0 - args.scale);
+        }
+    }
+
+    return 0;
+}
+
+    static void
+print_result(const struct job_result *res)
+{
+    printf("%-6s %4dx%-4d %5d tiles %8.1f tiles/h  %7.1f s real (%5.2f s wall)  %6.1f MB peak RSS\n",
+           mask_kind_name(res->kind), res->width, res->height, res->tiles,
+           res->tiles * 3600.0 / res->real_s, res->real_s, res->wall_s,
+           res->peak_rss_kb / 1024.0);
+
+    for (int p = 0; p < PH_COUNT; p++) {
+        printf("    %-10s %9.3f s %5.1f%%\n", phases[p].name, res->phase_s[p],
+               100.0 * res->phase_s[p] / res->real_s);
+    }
+}
+
+    static int
+write_json(const char *path, const std::vector<struct job_result>& results)
+{
+    FILE *f = fopen(path, "w");
+
+    if (f == NULL) {
+        perror("json:");
+        return -1;
+    }
+
+    fprintf(f, "{\"time_scale\":%g,\"exposure_ms\":%d,\"mono\":%s,\"jobs\":[\n",
+            args.scale, args.time, args.mono ? "true" : "false");
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const struct job_result *res = &results[i];
+
+        fprintf(f, "  {\"mask\":\"%s\",\"width\":%d,\"height\":%d,\"tiles\":%d,"
+                "\"tiles_per_hour\":%.3f,\"real_s\":%.6f,\"wall_s\":%.6f,"
+                "\"peak_rss_kb\":%ld,\"phases_s\":{",
+                mask_kind_name(res->kind), res->width, res->height, res->tiles,
+                res->tiles * 3600.0 / res->real_s, res->real_s, res->wall_s,
+                res->peak_rss_kb);
+
+        for (int p = 0; p < PH_COUNT; p++) {
+            fprintf(f, "%s\"%s\":%.6f", p ? "," : "", phases[p].name, res->phase_s[p]);
+        }
+
+        fprintf(f, "}}%s\n", i + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(f, "]}\n");
+    fclose(f);
+
+    return 0;
+}
+
+    error_t
+parse_opt(int key, char *arg, struct argp_state *state)
+{
+    struct arguments *arguments = (struct arguments *)state->input;
+
+    switch (key) {
+        case 'P':
+            arguments->pgraphy = arg;
+            break;
+        case 'E':
+            arguments->emu = arg;
+            break;
+        case 'w':
+            arguments->work_dir = arg;
+            break;
+        case 'j':
+            arguments->json = arg;
+            break;
+        case 's':
+            arguments->scale = atof(arg);
+            if (arguments->scale <= 0.0 || arguments->scale > 1.0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
+        case 't':
+            arguments->time = atoi(arg);
+            break;
+        case 'm':
+            arguments->mono = true;
+            break;
+        case 'v':
+            arguments->verbose = true;
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+struct argp_option options[] = {
+    { "pgraphy", 'P', "PATH", 0, "pgraphy binary [Default ./pgraphy]" },
+    { "emu", 'E', "PATH", 0, "table_emu binary [Default ./table_emu]" },
+    { "work", 'w', "DIR", 0, "Directory for masks, traces and the pty link [Default /tmp/job_bench]" },
+    { "json", 'j', "FILE", 0, "Write results as JSON to FILE" },
+    { "scale", 's', "SCALE", 0, "Time scale of table and exposure waits, (0;1] [Default 0.01]" },
+    { "time", 't', "TIME", 0, "Exposure time per tile (in ms) [Default 1000]" },
+    { "mono", 'm', 0, 0, "Run pgraphy in 8bpp monochrome mode" },
+    { "verbose", 'v', 0, 0, "Show pgraphy output" },
+    { 0 }
+};
+
+char doc[] = "End-to-end pgraphy throughput benchmark against table_emu";
+char args_doc[] = " [OPTIONS]";
+
+struct argp argp = { options, parse_opt, args_doc, doc };
+
+    int
+main(int argc, char **argv)
+{
+    std::vector<struct job_result> results;
+    int ret = 0;
+
+    args.pgraphy = (char *)"./pgraphy";
+    args.emu = (char *)"./table_emu";
+    args.work_dir = (char *)"/tmp/job_bench";
+    args.json = NULL;
+    args.scale = 0.01;
+    args.time = 1000;
+    args.mono = false;
+    args.verbose = false;
+
+    argp_parse(&argp, argc, argv, 0, 0, &args);
+
+    if (mkdir(args.work_dir, 0755) == -1 && errno != EEXIST) {
+        perror("work dir:");
+        return -1;
+    }
+
+    for (int kind = MASK_LINES; kind < MASK_KIND_COUNT; kind++) {
+        for (size_t s = 0; s < N_JOB_SIZES; s++) {
+            struct job_result res;
+
+            if (run_job((enum mask_kind)kind, job_sizes[s].width, job_sizes[s].height, &res) != 0) {
+                ret = -1;
+                continue;
+            }
+
+            print_result(&res);
+            results.push_back(res);
+        }
+    }
+
+    if (args.json != NULL && write_json(args.json, results) != 0) {
+        ret = -1;
+    }
+
+    return ret;
+}
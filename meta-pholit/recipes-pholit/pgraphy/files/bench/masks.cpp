@@ -0,0 +1,88 @@
+#include <stdlib.h>
+
+#include "masks.hpp"
+
+static const char *mask_kind_names[MASK_KIND_COUNT] = {
+    "lines",
+    "grid",
+    "blobs",
+    "mixed",
+};
+
+    const char *
+mask_kind_name(enum mask_kind kind)
+{
+    return mask_kind_names[kind];
+}
+
+    static void
+draw_lines(cv::Mat& mask, cv::Rect area, int pitch)
+{
+    for (int x = area.x; x + pitch <= area.x + area.width; x += 4 * pitch) {
+        mask(cv::Rect(x, area.y, pitch, area.height)) = cv::Scalar::all(255);
+    }
+}
+
+    static void
+draw_grid(cv::Mat& mask, cv::Rect area, int pitch)
+{
+    for (int y = area.y; y + pitch <= area.y + area.height; y += 2 * pitch) {
+        for (int x = area.x; x + pitch <= area.x + area.width; x += 2 * pitch) {
+            mask(cv::Rect(x, y, pitch, pitch)) = cv::Scalar::all(255);
+        }
+    }
+}
+
+    static void
+draw_blobs(cv::Mat& mask, cv::Rect area, int pitch, int count)
+{
+    for (int i = 0; i < count; i++) {
+        int w = pitch * (1 + rand() % 6);
+        int h = pitch * (1 + rand() % 6);
+
+        if (w >= area.width || h >= area.height) {
+            continue;
+        }
+
+        int x = area.x + rand() % (area.width - w);
+        int y = area.y + rand() % (area.height - h);
+
+        mask(cv::Rect(x, y, w, h)) = cv::Scalar::all(255);
+        mask(cv::Rect(x + w / 2, area.y, 1 + pitch / 4, y - area.y)) = cv::Scalar::all(255);
+    }
+}
+
+/*
+ * Mostly binary like a real mask, with a little antialiasing at the edges.
+ * Seeded from the size so every run gets the same mask.
+ */
+    cv::Mat
+make_mask(enum mask_kind kind, int width, int height)
+{
+    cv::Mat mask = cv::Mat::zeros(height, width, CV_8UC3);
+    cv::Rect full(0, 0, width, height);
+    int pitch = width / 64 > 2 ? width / 64 : 2;
+
+    srand(width * height + kind);
+
+    switch (kind) {
+        case MASK_LINES:
+            draw_lines(mask, full, pitch);
+            break;
+        case MASK_GRID:
+            draw_grid(mask, full, pitch / 2 > 1 ? pitch / 2 : 1);
+            break;
+        case MASK_BLOBS:
+            draw_blobs(mask, full, pitch, 96);
+            break;
+        case MASK_MIXED:
+        default:
+            draw_lines(mask, cv::Rect(0, height / 8, width / 2, height / 3), pitch / 2);
+            draw_blobs(mask, cv::Rect(width / 2, 0, width / 2, height), pitch, 48);
+            break;
+    }
+
+    cv::GaussianBlur(mask, mask, cv::Size(3, 3), 0);
+
+    return mask;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+enum mask_kind {
+    MASK_LINES,     // sparse line/space gratings
+    MASK_GRID,      // dense contact grid
+    MASK_BLOBS,     // random pads with routing
+    MASK_MIXED,     // gratings left, pads right
+    MASK_KIND_COUNT,
+};
+
+const char *mask_kind_name(enum mask_kind kind);
+cv::Mat make_mask(enum mask_kind kind, int width, int height);
@@ -0,0 +1,225 @@
+/*
+ * Micro benchmarks of the pgraphy exposure pipeline stages.
+ *
+ * Run with --benchmark_format=json (or --benchmark_out=FILE) to track results.
+ * Frames go to the null sink unless PGRAPHY_BENCH_SINK selects another one,
+ * e.g. PGRAPHY_BENCH_SINK=fb PGRAPHY_BENCH_FB=/dev/fb0 on the target.
+ */
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "image.hpp"
+#include "sink.hpp"
+#include "masks.hpp"
+#include "feather.hpp"
+#include "plan.hpp"
+
+struct bench_res {
+    int width, height;
+};
+
+// Mask sizes from a single projector frame up to a 4K source
+static const struct bench_res resolutions[] = {
+    { 640, 360 },
+    { 1280, 720 },
+    { 1920, 1080 },
+    { 3840, 2160 },
+};
+
+#define N_RESOLUTIONS   (sizeof(resolutions)/sizeof(resolutions[0]))
+
+    static const char *
+mask_path(int res)
+{
+    static char paths[N_RESOLUTIONS][64];
+
+    if (paths[res][0] == '\0') {
+        snprintf(paths[res], sizeof(paths[res]), "/tmp/pgraphy_bench_%dx%d.png",
+                 resolutions[res].width, resolutions[res].height);
+        cv::imwrite(paths[res], make_mask(MASK_MIXED, resolutions[res].width,
+                                           resolutions[res].height));
+    }
+
+    return paths[res];
+}
+
+    static void
+set_res_label(benchmark::State& state, int res)
+{
+    char label[32];
+
+    snprintf(label, sizeof(label), "%dx%d", resolutions[res].width, resolutions[res].height);
+    state.SetLabel(label);
+}
+
+// Args: resolution index, brightness, mono
+    static void
+BM_read_img(benchmark::State& state)
+{
+    int res = state.range(0);
+    const char *path = mask_path(res);
+
+    for (auto _ : state) {
+        cv::Mat img = read_img(path, state.range(1), state.range(2));
+        benchmark::DoNotOptimize(img.data);
+    }
+
+    set_res_label(state, res);
+}
+
+// Args: resolution index, mono
+    static void
+BM_resize_main(benchmark::State& state)
+{
+    int res = state.range(0);
+    cv::Mat src = read_img(mask_path(res), 255, state.range(1));
+    cv::Mat dst;
+
+    for (auto _ : state) {
+        cv::resize(src, dst, cv::Size(WIDTH, HEIGHT));
+        benchmark::DoNotOptimize(dst.data);
+    }
+
+    set_res_label(state, res);
+}
+
+// Args: mono
+    static void
+BM_prepare_tile(benchmark::State& state)
+{
+    cv::Mat img = read_img(mask_path(0), 255, state.range(0));
+    cv::Rect sub(WIDTH / 2, 0, WIDTH / 4, HEIGHT / 2);
+    struct tile_geometry geo;
+
+    tile_geometry_init(&geo, img.cols, img.rows, sub.width, sub.height, 0, img.channels());
+
+    for (auto _ : state) {
+        cv::Mat tile = prepare_tile(&geo, img, sub);
+        benchmark::DoNotOptimize(tile.data);
+    }
+
+    state.SetBytesProcessed(state.iterations() * WIDTH * HEIGHT * (state.range(0) ? 1 : 3));
+}
+
+// Args: mono, the same tile with the interior seam mask of --overlap 20
+    static void
+BM_prepare_tile_feathered(benchmark::State& state)
+{
+    cv::Mat img = read_img(mask_path(0), 255, state.range(0));
+    struct feather feather = {};
+    struct tile_geometry geo;
+    cv::Rect sub(WIDTH / 2, 0, SINGLE_IMG_WIDTH_UM, SINGLE_IMG_HEIGHT_UM);
+
+    cv::resize(img, img, cv::Size(WIDTH, HEIGHT));
+    tile_geometry_init(&geo, WIDTH, HEIGHT, SINGLE_IMG_WIDTH_UM, SINGLE_IMG_HEIGHT_UM, 20,
+                       img.channels());
+    feather_build(&feather, &geo, 20);
+
+    for (auto _ : state) {
+        cv::Mat tile = prepare_tile(&geo, img, sub, &feather.masks.back());
+        benchmark::DoNotOptimize(tile.data);
+    }
+
+    state.SetBytesProcessed(state.iterations() * WIDTH * HEIGHT * (state.range(0) ? 1 : 3));
+}
+
+// Args: mono, planes
+    static void
+BM_split_planes(benchmark::State& state)
+{
+    cv::Mat img = read_img(mask_path(0), 255, state.range(0));
+    struct tile_geometry geo;
+    std::vector<cv::Mat> planes;
+
+    tile_geometry_init(&geo, img.cols, img.rows, WIDTH / 4, HEIGHT / 2, 0, img.channels());
+
+    cv::Mat tile = prepare_tile(&geo, img, cv::Rect(0, 0, WIDTH / 4, HEIGHT / 2));
+
+    for (auto _ : state) {
+        split_planes(tile, state.range(1), planes);
+        benchmark::DoNotOptimize(planes.back().data);
+    }
+
+    state.SetBytesProcessed(state.iterations() * tile.total() * tile.elemSize());
+}
+
+// Args: mono
+    static void
+BM_write_img(benchmark::State& state)
+{
+    cv::Mat img = read_img(mask_path(0), 255, state.range(0));
+    struct tile_geometry geo;
+
+    tile_geometry_init(&geo, img.cols, img.rows, WIDTH / 4, HEIGHT / 2, 0, img.channels());
+
+    cv::Mat tile = prepare_tile(&geo, img, cv::Rect(0, 0, WIDTH / 4, HEIGHT / 2));
+    uint32_t size = tile.total() * tile.elemSize();
+
+    if (fb_set_mono(state.range(0)) != 0) {
+        state.SkipWithError("fb_set_mono failed");
+        return;
+    }
+
+    for (auto _ : state) {
+        write_img(tile.data, size);
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+// Args: mono
+    static void
+BM_blackout_screen(benchmark::State& state)
+{
+    if (fb_set_mono(state.range(0)) != 0) {
+        state.SkipWithError("fb_set_mono failed");
+        return;
+    }
+
+    for (auto _ : state) {
+        blackout_screen();
+    }
+
+    state.SetBytesProcessed(state.iterations() * frame_size);
+}
+
+BENCHMARK(BM_read_img)
+    ->ArgNames({"res", "brightness", "mono"})
+    ->ArgsProduct({{0, 1, 2, 3}, {255, 128, 51}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_resize_main)
+    ->ArgNames({"res", "mono"})
+    ->ArgsProduct({{0, 1, 2, 3}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_prepare_tile)->ArgName("mono")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_prepare_tile_feathered)->ArgName("mono")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_split_planes)
+    ->ArgNames({"mono", "planes"})
+    ->ArgsProduct({{0, 1}, {4, 8}})
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_write_img)->ArgName("mono")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_blackout_screen)->ArgName("mono")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+    int
+main(int argc, char **argv)
+{
+    const char *spec = getenv("PGRAPHY_BENCH_SINK");
+    const char *fb_path = getenv("PGRAPHY_BENCH_FB");
+
+    benchmark::Initialize(&argc, argv);
+
+    sink = sink_create(spec ? spec : "null", fb_path ? fb_path : "/dev/fb0");
+    if (sink == NULL) {
+        return -1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    delete sink;
+
+    return 0;
+}
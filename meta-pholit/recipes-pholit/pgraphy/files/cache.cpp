@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "cache.hpp"
+#include "hash.hpp"
+#include "log.h"
+
+const char *cache_dir = CACHE_DIR_DEFAULT;
+
+    std::string
+cache_path(const char *kind, uint64_t key)
+{
+    char name[64];
+
+    snprintf(name, sizeof(name), "/%s-%016llx.bin", kind, (unsigned long long)key);
+
+    return std::string(cache_dir) + name;
+}
+
+    int
+cache_read(const char *kind, uint32_t magic, uint64_t key, std::vector<uint8_t>& data)
+{
+    std::string path = cache_path(kind, key);
+    FILE *f = fopen(path.c_str(), "rb");
+    struct cache_hdr hdr;
+    struct stat st;
+
+    if (f == NULL) {
+        return -1;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != magic ||
+        hdr.version != CACHE_VERSION || hdr.key != key) {
+        fclose(f);
+        return -1;
+    }
+
+    // A truncated or garbled header must not size the allocation
+    if (fstat(fileno(f), &st) == -1 || (uint64_t)st.st_size != sizeof(hdr) + hdr.len) {
+        LOG(LOG_WARN, "Ignoring corrupted cache entry %s\n", path.c_str());
+        fclose(f);
+        return -1;
+    }
+
+    data.resize(hdr.len);
+
+    if (fread(data.data(), 1, hdr.len, f) != hdr.len ||
+        hash64(data.data(), data.size(), key) != hdr.check) {
+        LOG(LOG_WARN, "Ignoring corrupted cache entry %s\n", path.c_str());
+        fclose(f);
+        return -1;
+    }
+
+    fclose(f);
+
+    return 0;
+}
+
+// Failing to cache is not fatal, the entry is built again next time
+    int
+cache_write(const char *kind, uint32_t magic, uint64_t key, const std::vector<uint8_t>& data)
+{
+    std::string path = cache_path(kind, key);
+    std::string tmp = path + ".tmp";
+    struct cache_hdr hdr;
+    FILE *f;
+
+    if (mkdir(cache_dir, 0755) == -1 && errno != EEXIST) {
+        LOG(LOG_WARN, "Cannot create cache dir %s: %d\n", cache_dir, errno);
+        return -1;
+    }
+
+    f = fopen(tmp.c_str(), "wb");
+    if (f == NULL) {
+        LOG(LOG_WARN, "Cannot write %s: %d\n", tmp.c_str(), errno);
+        return -1;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = magic;
+    hdr.version = CACHE_VERSION;
+    hdr.key = key;
+    hdr.len = data.size();
+    hdr.check = hash64(data.data(), data.size(), key);
+
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+              fwrite(data.data(), 1, data.size(), f) == data.size();
+
+    if (fclose(f) != 0 || !ok) {
+        LOG(LOG_WARN, "Cannot write %s: %d\n", tmp.c_str(), errno);
+        remove(tmp.c_str());
+        return -1;
+    }
+
+    // Readers only ever see a complete entry
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        return -1;
+    }
+
+    return 0;
+}
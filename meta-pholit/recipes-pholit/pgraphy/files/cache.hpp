@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * On-disk cache of data that is slow to derive from the calibration, like
+ * remap tables. Entries are named by kind and a hash of everything they
+ * were built from, so a changed calibration simply misses.
+ */
+
+#define CACHE_DIR_DEFAULT   "/var/cache/pgraphy"
+#define CACHE_VERSION       1
+
+struct cache_hdr {
+    uint32_t magic;     // kind of entry
+    uint32_t version;
+    uint64_t key;
+    uint64_t len;
+    uint64_t check;     // of the payload
+};
+
+extern const char *cache_dir;
+
+std::string cache_path(const char *kind, uint64_t key);
+int cache_read(const char *kind, uint32_t magic, uint64_t key, std::vector<uint8_t>& data);
+int cache_write(const char *kind, uint32_t magic, uint64_t key, const std::vector<uint8_t>& data);
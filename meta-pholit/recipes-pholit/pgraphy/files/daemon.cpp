@@ -0,0 +1,588 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "daemon.hpp"
+#include "plan.hpp"
+#include "image.hpp"
+#include "log.h"
+
+#define DAEMON_BACKLOG          4
+#define DAEMON_MAX_LINE         512
+// Finished jobs kept around for status/wait
+#define DAEMON_JOB_HISTORY      64
+
+typedef std::shared_ptr<struct job> job_ptr;
+
+struct job_order {
+    bool operator()(const job_ptr& a, const job_ptr& b) const
+    {
+        // Highest priority first, FIFO within a priority
+        return a->prio != b->prio ? a->prio < b->prio : a->id > b->id;
+    }
+};
+
+static std::mutex jobs_lock;
+static std::condition_variable jobs_cv;
+static std::priority_queue<job_ptr, std::vector<job_ptr>, job_order> job_queue;
+static std::map<uint32_t, job_ptr> jobs;
+static uint32_t job_next_id = 1;
+
+static volatile sig_atomic_t daemon_stop;
+static int daemon_fd = -1;
+static struct job *volatile job_running;
+
+// The socket is closed only once the thread is joined, shutdown() stops it
+struct client {
+    int fd;
+    std::thread thread;
+    std::atomic<bool> done;
+};
+
+static std::mutex clients_lock;
+static std::list<struct client> clients;
+
+static const char *job_state_names[] = {
+    "queued",
+    "running",
+    "done",
+    "failed",
+    "cancelled",
+};
+
+    const char *
+job_state_name(int state)
+{
+    return job_state_names[state];
+}
+
+    static void
+daemon_signal(int sig)
+{
+    struct job *job = job_running;
+
+    (void)sig;
+    daemon_stop = 1;
+
+    if (job != NULL) {
+        job->cancel = true;
+    }
+
+    // Wakes up accept()
+    shutdown(daemon_fd, SHUT_RDWR);
+}
+
+    static bool
+job_finished(const struct job *job)
+{
+    return job->state.load() >= JOB_DONE;
+}
+
+    static void
+jobs_prune(void)
+{
+    size_t finished = 0;
+
+    for (auto& it : jobs) {
+        finished += job_finished(it.second.get());
+    }
+
+    for (auto it = jobs.begin(); it != jobs.end() && finished > DAEMON_JOB_HISTORY; ) {
+        if (job_finished(it->second.get())) {
+            it = jobs.erase(it);
+            finished--;
+        } else {
+            it++;
+        }
+    }
+}
+
+    static int
+job_set_param(struct job *job, const char *key, const char *val)
+{
+    if (strcmp(key, "file") == 0) {
+        job->file = val;
+    } else if (strcmp(key, "prio") == 0) {
+        job->prio = atoi(val);
+    } else if (strcmp(key, "time") == 0) {
+        job->time = atoi(val);
+    } else if (strcmp(key, "brightness") == 0) {
+        int b = atoi(val);
+
+        if (b < 0 || b > 255) {
+            return -1;
+        }
+        job->brightness = b;
+    } else if (strcmp(key, "xstep") == 0) {
+        job->xstep = atoi(val);
+    } else if (strcmp(key, "ystep") == 0) {
+        job->ystep = atoi(val);
+    } else if (strcmp(key, "overlap") == 0) {
+        int o = atoi(val);
+
+        if (o < 0) {
+            return -1;
+        }
+        job->overlap = o;
+    } else if (strcmp(key, "xsize") == 0) {
+        job->xsize = atoi(val);
+    } else if (strcmp(key, "ysize") == 0) {
+        job->ysize = atoi(val);
+    } else if (strcmp(key, "tile") == 0) {
+        if (sscanf(val, "%dx%d", &job->tile_w, &job->tile_h) != 2) {
+            return -1;
+        }
+    } else if (strcmp(key, "psf") == 0) {
+        return psf_parse(&job->psf, val);
+    } else if (strcmp(key, "mono") == 0) {
+        job->mono = atoi(val) != 0;
+    } else if (strcmp(key, "grey") == 0) {
+        int g = atoi(val);
+
+        if (g < 0 || g > GREY_PLANES_MAX) {
+            return -1;
+        }
+        job->grey = g;
+    } else if (strcmp(key, "dose") == 0) {
+        job->dose = val;
+    } else if (strcmp(key, "wafer") == 0) {
+        job->wafer = val;
+    } else if (strcmp(key, "adaptive") == 0) {
+        job->adaptive = atoi(val) != 0;
+    } else if (strcmp(key, "plan") == 0) {
+        job->plan = val;
+    } else if (strcmp(key, "order") == 0) {
+        job->order = plan_order_parse(val);
+
+        if (job->order < 0) {
+            return -1;
+        }
+    } else if (strcmp(key, "journal") == 0) {
+        job->journal = val;
+    } else if (strcmp(key, "resume") == 0) {
+        job->resume = atoi(val) != 0;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+    static void
+cmd_submit(FILE *out, char *params, const struct job *defaults)
+{
+    job_ptr job = std::make_shared<struct job>();
+    char *save;
+
+    job->prio = 0;
+    job->file = "";
+    job->time = defaults->time;
+    job->brightness = defaults->brightness;
+    job->xstep = defaults->xstep;
+    job->ystep = defaults->ystep;
+    job->overlap = defaults->overlap;
+    job->xsize = defaults->xsize;
+    job->ysize = defaults->ysize;
+    job->tile_w = defaults->tile_w;
+    job->tile_h = defaults->tile_h;
+    job->psf = defaults->psf;
+    job->mono = defaults->mono;
+    job->grey = defaults->grey;
+    job->dose = defaults->dose;
+    job->adaptive = defaults->adaptive;
+    job->wafer = defaults->wafer;
+    job->plan = "";
+    job->order = defaults->order;
+    job->journal = "";
+    job->resume = false;
+    job->state = JOB_QUEUED;
+    job->tiles_done = 0;
+    job->tiles_total = 0;
+    job->cancel = false;
+
+    for (char *tok = strtok_r(params, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save)) {
+        char *eq = strchr(tok, '=');
+
+        if (eq == NULL) {
+            fprintf(out, "err bad parameter %s\n", tok);
+            return;
+        }
+        *eq = '\0';
+
+        if (job_set_param(job.get(), tok, eq + 1) != 0) {
+            fprintf(out, "err bad parameter %s\n", tok);
+            return;
+        }
+    }
+
+    if (job->file.empty()) {
+        fprintf(out, "err file is mandatory\n");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(jobs_lock);
+
+    job->id = job_next_id++;
+    jobs[job->id] = job;
+    job_queue.push(job);
+    jobs_cv.notify_all();
+
+    LOG(LOG_INFO, "Queued job %u prio %d: %s\n", job->id, job->prio, job->file.c_str());
+    fprintf(out, "ok %u\n", job->id);
+}
+
+    static void
+print_job(FILE *out, const struct job *job)
+{
+    fprintf(out, "%u %s prio=%d tiles=%d/%d file=%s\n", job->id,
+            job_state_name(job->state), job->prio, job->tiles_done.load(),
+            job->tiles_total.load(), job->file.c_str());
+}
+
+    static void
+cmd_status(FILE *out, const char *arg)
+{
+    std::lock_guard<std::mutex> lock(jobs_lock);
+
+    if (*arg != '\0') {
+        auto it = jobs.find(strtoul(arg, NULL, 10));
+
+        if (it == jobs.end()) {
+            fprintf(out, "err no such job\n");
+            return;
+        }
+
+        print_job(out, it->second.get());
+    } else {
+        for (auto& it : jobs) {
+            print_job(out, it.second.get());
+        }
+    }
+
+    fprintf(out, "ok\n");
+}
+
+    static void
+cmd_cancel(FILE *out, const char *arg)
+{
+    std::lock_guard<std::mutex> lock(jobs_lock);
+    auto it = jobs.find(strtoul(arg, NULL, 10));
+
+    if (it == jobs.end() || job_finished(it->second.get())) {
+        fprintf(out, "err no such job\n");
+        return;
+    }
+
+    // A queued job is dropped by the worker, a running one stops at the next tile
+    it->second->cancel = true;
+    fprintf(out, "ok\n");
+}
+
+    static void
+cmd_wait(FILE *out, const char *arg)
+{
+    std::unique_lock<std::mutex> lock(jobs_lock);
+    auto it = jobs.find(strtoul(arg, NULL, 10));
+
+    if (it == jobs.end()) {
+        fprintf(out, "err no such job\n");
+        return;
+    }
+
+    job_ptr job = it->second;
+
+    jobs_cv.wait(lock, [&job] { return job_finished(job.get()) || daemon_stop; });
+
+    fprintf(out, "ok %u %s tiles=%d/%d\n", job->id, job_state_name(job->state),
+            job->tiles_done.load(), job->tiles_total.load());
+}
+
+    static void
+client_serve(FILE *in, FILE *out, const struct job *defaults)
+{
+    char line[DAEMON_MAX_LINE];
+
+    while (!daemon_stop && fgets(line, sizeof(line), in) != NULL) {
+        char *arg;
+
+        line[strcspn(line, "\r\n")] = '\0';
+
+        arg = line + strcspn(line, " \t");
+        if (*arg != '\0') {
+            *arg++ = '\0';
+        }
+
+        if (strcmp(line, "submit") == 0) {
+            cmd_submit(out, arg, defaults);
+        } else if (strcmp(line, "status") == 0) {
+            cmd_status(out, arg);
+        } else if (strcmp(line, "cancel") == 0) {
+            cmd_cancel(out, arg);
+        } else if (strcmp(line, "wait") == 0) {
+            cmd_wait(out, arg);
+        } else if (strcmp(line, "shutdown") == 0) {
+            fprintf(out, "ok\n");
+            fflush(out);
+            daemon_signal(0);
+            jobs_cv.notify_all();
+        } else if (line[0] != '\0') {
+            fprintf(out, "err unknown command %s\n", line);
+        }
+
+        fflush(out);
+    }
+}
+
+    static void
+client_thread(struct client *c, const struct job *defaults)
+{
+    int in_fd = dup(c->fd), out_fd = dup(c->fd);
+    FILE *in = in_fd == -1 ? NULL : fdopen(in_fd, "r");
+    FILE *out = out_fd == -1 ? NULL : fdopen(out_fd, "w");
+
+    if (in != NULL && out != NULL) {
+        client_serve(in, out, defaults);
+    }
+
+    if (in != NULL) {
+        fclose(in);
+    } else if (in_fd != -1) {
+        close(in_fd);
+    }
+
+    if (out != NULL) {
+        fclose(out);
+    } else if (out_fd != -1) {
+        close(out_fd);
+    }
+
+    c->done = true;
+}
+
+// Joins the clients that hung up, or with all every one of them after a shutdown()
+    static void
+clients_reap(bool all)
+{
+    std::list<struct client> gone;
+
+    {
+        std::lock_guard<std::mutex> lock(clients_lock);
+
+        for (auto it = clients.begin(); it != clients.end(); ) {
+            auto next = std::next(it);
+
+            if (all) {
+                shutdown(it->fd, SHUT_RDWR);
+            }
+            if (all || it->done) {
+                gone.splice(gone.end(), clients, it);
+            }
+            it = next;
+        }
+    }
+
+    for (struct client& c : gone) {
+        c.thread.join();
+        close(c.fd);
+    }
+}
+
+    static void
+accept_thread(const struct job *defaults)
+{
+    while (!daemon_stop) {
+        int fd = accept(daemon_fd, NULL, NULL);
+
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+
+        clients_reap(false);
+
+        std::lock_guard<std::mutex> lock(clients_lock);
+        struct client& c = clients.emplace_back();
+
+        c.fd = fd;
+        c.done = false;
+        c.thread = std::thread(client_thread, &c, defaults);
+    }
+
+    daemon_stop = 1;
+    jobs_cv.notify_all();
+}
+
+    static job_ptr
+job_next(void)
+{
+    std::unique_lock<std::mutex> lock(jobs_lock);
+
+    while (!daemon_stop) {
+        if (job_queue.empty()) {
+            // Polled as well, a signal cannot notify the condition variable
+            jobs_cv.wait_for(lock, std::chrono::milliseconds(200));
+            continue;
+        }
+
+        job_ptr job = job_queue.top();
+        job_queue.pop();
+
+        if (job->cancel) {
+            job->state = JOB_CANCELLED;
+            jobs_cv.notify_all();
+            continue;
+        }
+
+        return job;
+    }
+
+    return NULL;
+}
+
+/*
+ * Whatever is at path is only removed if it is a socket nobody listens on,
+ * a second daemon or a mistyped path to some file must not lose it
+ */
+    static int
+socket_unlink_stale(const struct sockaddr_un *addr)
+{
+    struct stat st;
+    int fd, ret;
+
+    if (lstat(addr->sun_path, &st) == -1) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        perror("lstat:");
+        return -1;
+    }
+
+    if (!S_ISSOCK(st.st_mode)) {
+        fprintf(stderr, "%s exists and is not a socket\n", addr->sun_path);
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket:");
+        return -1;
+    }
+
+    ret = connect(fd, (const struct sockaddr *)addr, sizeof(*addr));
+    close(fd);
+
+    if (ret == 0) {
+        fprintf(stderr, "Another daemon is serving %s\n", addr->sun_path);
+        return -1;
+    }
+
+    if (errno != ECONNREFUSED) {
+        perror("connect:");
+        return -1;
+    }
+
+    if (unlink(addr->sun_path) == -1) {
+        perror("unlink:");
+        return -1;
+    }
+
+    return 0;
+}
+
+    int
+daemon_run(const char *path, const struct job *defaults)
+{
+    struct sockaddr_un addr;
+    struct sigaction sa;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long\n");
+        return -1;
+    }
+
+    daemon_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (daemon_fd == -1) {
+        perror("socket:");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (socket_unlink_stale(&addr) != 0) {
+        close(daemon_fd);
+        return -1;
+    }
+
+    if (bind(daemon_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(daemon_fd, DAEMON_BACKLOG) == -1) {
+        perror("bind:");
+        close(daemon_fd);
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = daemon_signal;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    LOG(LOG_INFO, "Waiting for jobs on %s\n", path);
+
+    std::thread acceptor(accept_thread, defaults);
+
+    for (job_ptr job = job_next(); job; job = job_next()) {
+        LOG(LOG_INFO, "Running job %u: %s\n", job->id, job->file.c_str());
+
+        job_running = job.get();
+        run_job(job.get());
+        job_running = NULL;
+
+        LOG(LOG_INFO, "Job %u %s, %d/%d tiles\n", job->id, job_state_name(job->state),
+            job->tiles_done.load(), job->tiles_total.load());
+
+        std::lock_guard<std::mutex> lock(jobs_lock);
+        jobs_prune();
+        jobs_cv.notify_all();
+    }
+
+    daemon_signal(0);
+    acceptor.join();
+    close(daemon_fd);
+    unlink(path);
+
+    {
+        std::lock_guard<std::mutex> lock(jobs_lock);
+        for (auto& it : jobs) {
+            if (!job_finished(it.second.get())) {
+                it.second->state = JOB_CANCELLED;
+            }
+        }
+        jobs_cv.notify_all();
+    }
+
+    // Clients in a read or a wait let go now, none may outlive the jobs they point at
+    clients_reap(true);
+
+    return 0;
+}
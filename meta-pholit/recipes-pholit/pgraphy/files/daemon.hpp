@@ -0,0 +1,22 @@
+#pragma once
+
+#include "job.hpp"
+
+/*
+ * Serves jobs from a Unix socket until "shutdown" or SIGTERM, running them
+ * one at a time on the calling thread. Line protocol, every reply ends with
+ * an "ok ..." or "err ..." line:
+ *
+ *  submit file=PATH [prio=N] [time=MS] [brightness=B] [xstep=S] [ystep=S] [mono=0|1]
+ *         [xsize=UM] [ysize=UM] [tile=WxH] [overlap=PX] [psf=SIGMA,ETA] [grey=PLANES]
+ *         [dose=PATH] [adaptive=0|1] [wafer=PATH] [plan=PATH | order=raster|serpentine]
+ *         [journal=PATH [resume=0|1]]
+ *                      -> ok ID
+ *  status [ID]         -> one "ID STATE prio=N tiles=DONE/TOTAL file=PATH" line per job
+ *  cancel ID           -> ok
+ *  wait ID             -> ok ID STATE tiles=DONE/TOTAL, once the job has finished
+ *  shutdown            -> ok
+ *
+ * Parameters missing from submit are taken from defaults.
+ */
+int daemon_run(const char *path, const struct job *defaults);
@@ -0,0 +1,61 @@
+#include <stdio.h>
+
+#include <opencv2/opencv.hpp>
+
+#include "dose.hpp"
+#include "log.h"
+
+    int
+dose_map_load(struct dose_map *d, const char *path, int img_w, int img_h)
+{
+    int col, row, pct;
+    FILE *f;
+
+    d->img = cv::imread(path, cv::IMREAD_GRAYSCALE);
+    d->table.clear();
+
+    if (!d->img.empty()) {
+        cv::resize(d->img, d->img, cv::Size(img_w, img_h), 0, 0, cv::INTER_AREA);
+        LOG(LOG_INFO, "Dose map %s, %.0f%% on average\n", path, cv::mean(d->img)[0]);
+        return 0;
+    }
+
+    // Not an image, a table then
+    f = fopen(path, "r");
+    if (f == NULL) {
+        perror("dose:");
+        return -1;
+    }
+
+    while (fscanf(f, "%d %d %d", &col, &row, &pct) == 3) {
+        if (pct < 0) {
+            fprintf(stderr, "dose: negative dose for tile %d,%d\n", col, row);
+            fclose(f);
+            return -1;
+        }
+        d->table[std::make_pair(col, row)] = pct;
+    }
+
+    if (!feof(f)) {
+        fprintf(stderr, "dose: %s is neither an image nor a table\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    fclose(f);
+    LOG(LOG_INFO, "Dose table %s, %zu tiles\n", path, d->table.size());
+
+    return 0;
+}
+
+    double
+dose_map_scale(const struct dose_map *d, const cv::Rect& sub, int col, int row)
+{
+    if (!d->img.empty()) {
+        return cv::mean(d->img(sub))[0]/100.0;
+    }
+
+    auto it = d->table.find(std::make_pair(col, row));
+
+    return it == d->table.end() ? 1.0 : it->second/100.0;
+}
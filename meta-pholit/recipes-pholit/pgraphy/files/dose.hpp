@@ -0,0 +1,22 @@
+#pragma once
+
+#include <map>
+#include <utility>
+
+#include <opencv2/core.hpp>
+
+/*
+ * Dose per region of a layer in percent of --time, 100 being nominal.
+ * Either an image stretched over the whole job with the percentage as the
+ * pixel value, or a per tile table of "col row percent" lines where any
+ * tile left out gets 100.
+ */
+
+struct dose_map {
+    cv::Mat img;    // CV_8UC1, job image sized
+    std::map<std::pair<int, int>, int> table;
+};
+
+int dose_map_load(struct dose_map *d, const char *path, int img_w, int img_h);
+// Scale of --time for the tile at sub, 1.0 without a map
+double dose_map_scale(const struct dose_map *d, const cv::Rect& sub, int col, int row);
@@ -0,0 +1,112 @@
+#include <math.h>
+#include <string.h>
+
+#include <array>
+#include <map>
+
+#include "feather.hpp"
+#include "plan.hpp"
+
+// Ramp over the first lo and the last hi px, 1.0 elsewhere
+    static void
+feather_ramp(std::vector<float>& w, int size, int lo, int hi)
+{
+    w.assign(size, 1.0f);
+
+    for (int i = 0; i < lo; i++) {
+        w[i] = (i + 0.5f)/lo;
+    }
+
+    for (int i = 0; i < hi; i++) {
+        w[size - 1 - i] = (i + 0.5f)/hi;
+    }
+}
+
+// Bands shared with the previous and the next tile along an axis
+    static void
+feather_bands(const std::vector<int>& starts, int tile, int i, int *lo, int *hi)
+{
+    int n = starts.size();
+
+    *lo = i > 0 ? starts[i - 1] + tile - starts[i] : 0;
+    *hi = i < n - 1 ? starts[i] + tile - starts[i + 1] : 0;
+}
+
+    static cv::Mat
+feather_make(const struct tile_geometry *g, int lo_x, int hi_x, int lo_y, int hi_y)
+{
+    int channels = g->channels;
+    cv::Mat mask(g->tile_h, g->tile_w, CV_8UC(channels));
+    std::vector<float> wx, wy;
+
+    feather_ramp(wx, g->tile_w, lo_x, hi_x);
+    feather_ramp(wy, g->tile_h, lo_y, hi_y);
+
+    for (int y = 0; y < mask.rows; y++) {
+        uint8_t *p = mask.ptr(y);
+
+        for (int x = 0; x < mask.cols; x++) {
+            uint8_t w = (uint8_t)lrintf(wx[x]*wy[y]*255.0f);
+
+            for (int c = 0; c < channels; c++) {
+                *p++ = w;
+            }
+        }
+    }
+
+    return mask;
+}
+
+    void
+feather_build(struct feather *f, const struct tile_geometry *g, int overlap)
+{
+    int key[6] = { g->img_w, g->img_h, g->tile_w, g->tile_h, g->channels, overlap };
+    std::map<std::array<int, 4>, int> seen;
+    std::vector<int> xs, ys;
+
+    if (!f->tile_mask.empty() && memcmp(f->key, key, sizeof(key)) == 0) {
+        return;
+    }
+
+    memcpy(f->key, key, sizeof(key));
+    f->masks.clear();
+
+    plan_axis(xs, g->img_w, g->tile_w, overlap);
+    plan_axis(ys, g->img_h, g->tile_h, overlap);
+
+    int cols = xs.size();
+    int rows = ys.size();
+
+    f->tile_mask.assign(cols*rows, -1);
+
+    for (int col = 0; col < cols; col++) {
+        for (int row = 0; row < rows; row++) {
+            std::array<int, 4> bands;
+
+            feather_bands(xs, g->tile_w, col, &bands[0], &bands[1]);
+            feather_bands(ys, g->tile_h, row, &bands[2], &bands[3]);
+
+            if (bands[0] + bands[1] + bands[2] + bands[3] == 0) {
+                continue;
+            }
+
+            auto it = seen.find(bands);
+            if (it == seen.end()) {
+                it = seen.emplace(bands, (int)f->masks.size()).first;
+                f->masks.push_back(feather_make(g, bands[0], bands[1], bands[2], bands[3]));
+            }
+
+            f->tile_mask[plan_tile_index(col, row, cols, rows)] = it->second;
+        }
+    }
+}
+
+    const cv::Mat *
+feather_mask(const struct feather *f, uint32_t tile)
+{
+    if (tile >= f->tile_mask.size() || f->tile_mask[tile] < 0) {
+        return NULL;
+    }
+
+    return &f->masks[f->tile_mask[tile]];
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "geometry.hpp"
+
+/*
+ * Weights for overlapped tiling. Across a shared band one tile ramps down
+ * while its neighbour ramps up, so every pixel sums to the full dose.
+ * Tiles with the same seams share one mask, built once per geometry.
+ */
+
+struct feather {
+    int key[6];                     // what the masks were built for
+    std::vector<cv::Mat> masks;     // CV_8UC(channels), tile sized, 255 is full dose
+    std::vector<int> tile_mask;     // by raster tile index, -1 for no seams
+};
+
+// Keeps the masks if neither the geometry nor the overlap changed
+void feather_build(struct feather *f, const struct tile_geometry *g, int overlap);
+const cv::Mat *feather_mask(const struct feather *f, uint32_t tile);
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "flatfield.hpp"
+#include "kernels.hpp"
+#include "log.h"
+
+    int
+flat_field_load(struct flat_field *ff, const char *path, int out_w, int out_h)
+{
+    cv::Mat meas = cv::imread(path, cv::IMREAD_GRAYSCALE | cv::IMREAD_ANYDEPTH);
+    std::vector<float> sorted;
+    float ref;
+
+    if (meas.empty()) {
+        fprintf(stderr, "flat field: cannot read %s\n", path);
+        return -1;
+    }
+
+    meas.convertTo(meas, CV_32F);
+    cv::resize(meas, meas, cv::Size(out_w, out_h), 0, 0, cv::INTER_AREA);
+
+    sorted.assign((float *)meas.data, (float *)meas.data + meas.total());
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size()*FLAT_FIELD_REF_PCT/100,
+                     sorted.end());
+    ref = sorted[sorted.size()*FLAT_FIELD_REF_PCT/100];
+
+    if (ref <= 0.0f) {
+        fprintf(stderr, "flat field: %s is dark\n", path);
+        return -1;
+    }
+
+    ff->gain.create(out_h, out_w, CV_8UC1);
+    ff->scaled.clear();
+
+    for (int y = 0; y < out_h; y++) {
+        const float *m = meas.ptr<float>(y);
+        uint8_t *g = ff->gain.ptr(y);
+
+        for (int x = 0; x < out_w; x++) {
+            g[x] = m[x] <= ref ? 255 : (uint8_t)lrintf(255.0f*ref/m[x]);
+        }
+    }
+
+    double lo;
+    cv::minMaxLoc(ff->gain, &lo);
+    LOG(LOG_INFO, "Flat field %s, gain down to %.2f\n", path, lo/255.0);
+
+    return 0;
+}
+
+    const cv::Mat *
+flat_field_get(struct flat_field *ff, uint8_t brightness, int channels)
+{
+    auto key = std::make_pair((int)brightness, channels);
+    auto it = ff->scaled.find(key);
+
+    if (it != ff->scaled.end()) {
+        return &it->second;
+    }
+
+    cv::Mat& m = ff->scaled[key];
+
+    m.create(ff->gain.size(), CV_8UC(channels));
+
+    for (int y = 0; y < m.rows; y++) {
+        const uint8_t *g = ff->gain.ptr(y);
+        uint8_t *p = m.ptr(y);
+
+        for (int x = 0; x < m.cols; x++) {
+            uint8_t v = mul_div255(g[x], brightness);
+
+            for (int c = 0; c < channels; c++) {
+                *p++ = v;
+            }
+        }
+    }
+
+    return &m;
+}
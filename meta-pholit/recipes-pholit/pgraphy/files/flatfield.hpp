@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <utility>
+
+#include <opencv2/core.hpp>
+
+/*
+ * Per pixel gain over the projector field, so the dose is the same at the
+ * edges of a tile as in its middle. Stored as Q8, 255 being unity, and only
+ * ever attenuating: the brightest spots are brought down to the dim ones.
+ */
+
+struct flat_field {
+    cv::Mat gain;   // CV_8UC1, frame sized
+
+    // gain*brightness/255 expanded to the frame's channels, by (brightness, channels)
+    std::map<std::pair<int, int>, cv::Mat> scaled;
+};
+
+/*
+ * path is a measured flat field, any depth, one channel. Pixels are
+ * referenced to the FLAT_FIELD_REF_PCT percentile so dead ones don't set
+ * the gain for the whole field.
+ */
+#define FLAT_FIELD_REF_PCT      1
+
+int flat_field_load(struct flat_field *ff, const char *path, int out_w, int out_h);
+const cv::Mat *flat_field_get(struct flat_field *ff, uint8_t brightness, int channels);
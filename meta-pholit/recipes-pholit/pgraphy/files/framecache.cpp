@@ -0,0 +1,70 @@
+#include "framecache.hpp"
+#include "image.hpp"
+
+    int
+frame_cache_init(struct frame_cache *fc, int entries, int frames)
+{
+    fc->frames = frames;
+    fc->staged = -1;
+    fc->key.assign(entries, 0);
+    fc->used.assign(entries, 0);
+    fc->clock = 0;
+    fc->hits = 0;
+    fc->misses = 0;
+
+    fc->resident = slot_init(TILE_SLOT + (entries + 1)*frames);
+
+    return fc->resident;
+}
+
+    int
+frame_cache_get(struct frame_cache *fc, uint64_t key, bool *hit)
+{
+    size_t victim = 0;
+
+    fc->clock++;
+
+    for (size_t i = 0; i < fc->key.size(); i++) {
+        if (fc->used[i] != 0 && fc->key[i] == key) {
+            fc->used[i] = fc->clock;
+            fc->hits++;
+            *hit = true;
+            return TILE_SLOT + (i + 1)*fc->frames;
+        }
+
+        if (fc->used[i] < fc->used[victim]) {
+            victim = i;
+        }
+    }
+
+    fc->key[victim] = key;
+    fc->used[victim] = fc->clock;
+    fc->misses++;
+    *hit = false;
+
+    int base = TILE_SLOT + (victim + 1)*fc->frames;
+
+    // Gets a new frame, what is staged from it is stale
+    if (fc->staged == base) {
+        fc->staged = -1;
+    }
+
+    return base;
+}
+
+    int
+frame_cache_stage(struct frame_cache *fc, int base)
+{
+    if (base + fc->frames <= fc->resident) {
+        return base;
+    }
+
+    if (fc->staged != base) {
+        for (int k = 0; k < fc->frames; k++) {
+            copy_img_slot(TILE_SLOT + k, base + k);
+        }
+        fc->staged = base;
+    }
+
+    return TILE_SLOT;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+/*
+ * Prepared tile frames by content key, kept in sink slots so a tile seen
+ * before costs neither the preparation nor the upload. An entry is frames
+ * slots long, the bit planes with --grey. The least recently used entry
+ * makes room for a new one.
+ *
+ * The first frames slots from TILE_SLOT are staging, entries past the VRAM
+ * are copied there before the exposure so showing one is only a flip.
+ */
+
+// Cap on what the entries may take, most of it plain memory past the VRAM
+#define FRAME_CACHE_BYTES   (32u << 20)
+
+struct frame_cache {
+    int frames;
+    int resident;                   // slots in VRAM, staging included
+    int staged;                     // entry base the staging slots hold, -1 for none
+    std::vector<uint64_t> key;
+    std::vector<uint64_t> used;     // 0 for an empty entry
+    uint64_t clock;
+    uint32_t hits, misses;
+};
+
+// Returns how many slots ended up in VRAM or -1
+int frame_cache_init(struct frame_cache *fc, int entries, int frames);
+// First slot of the entry for key, *hit set if it already holds the frame
+int frame_cache_get(struct frame_cache *fc, uint64_t key, bool *hit);
+// First slot to show the entry at base from, staged first if it is not in VRAM
+int frame_cache_stage(struct frame_cache *fc, int base);
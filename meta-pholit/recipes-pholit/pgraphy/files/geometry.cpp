@@ -0,0 +1,68 @@
+#include <stdio.h>
+
+#include "geometry.hpp"
+#include "image.hpp"
+#include "kernels.hpp"
+
+    template <int CN, int W>
+    static void
+flip_shift(uint8_t *dst, const uint8_t *src, const struct tile_geometry *g)
+{
+    flip_shift_row<CN, W>(dst, src, g->out_w, g->shift, g->channels);
+}
+
+struct flip_shift_kernel {
+    int channels;
+    int width;
+    flip_shift_fn fn;
+    const char *name;
+};
+
+// First match wins, 0 matches anything. WIDTH is 640 for the lcdc panel
+static const struct flip_shift_kernel flip_shift_kernels[] = {
+    { 1, WIDTH, flip_shift<1, WIDTH>, "mono/640" },
+    { 3, WIDTH, flip_shift<3, WIDTH>, "rgb/640" },
+    { 1, 0, flip_shift<1, 0>, "mono" },
+    { 3, 0, flip_shift<3, 0>, "rgb" },
+    { 0, 0, flip_shift<0, 0>, "generic" },
+};
+
+#define N_KERNELS   (sizeof(flip_shift_kernels)/sizeof(flip_shift_kernels[0]))
+
+    int
+tile_geometry_init(struct tile_geometry *g, int img_w, int img_h, int tile_w, int tile_h,
+                   int overlap, int channels)
+{
+    if (tile_w <= 0 || tile_h <= 0 || tile_w > img_w || tile_h > img_h) {
+        fprintf(stderr, "Tile %dx%d does not fit the %dx%d image\n", tile_w, tile_h, img_w, img_h);
+        return -1;
+    }
+
+    // Beyond half a tile three tiles would share a band
+    if (overlap < 0 || 2*overlap >= tile_w || 2*overlap >= tile_h) {
+        fprintf(stderr, "Overlap %d is too large for a %dx%d tile\n", overlap, tile_w, tile_h);
+        return -1;
+    }
+
+    g->img_w = img_w;
+    g->img_h = img_h;
+    g->tile_w = tile_w;
+    g->tile_h = tile_h;
+    g->out_w = WIDTH;
+    g->out_h = HEIGHT;
+    g->shift = TILE_SHIFT_PX > 0 && TILE_SHIFT_PX < WIDTH ? TILE_SHIFT_PX : 0;
+    g->channels = channels;
+    g->remap = NULL;
+
+    for (size_t i = 0; i < N_KERNELS; i++) {
+        const struct flip_shift_kernel *k = &flip_shift_kernels[i];
+
+        if ((k->channels == 0 || k->channels == channels) && (k->width == 0 || k->width == g->out_w)) {
+            g->flip_shift = k->fn;
+            g->kernel = k->name;
+            break;
+        }
+    }
+
+    return 0;
+}
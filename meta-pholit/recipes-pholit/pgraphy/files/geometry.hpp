@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// Defaults for one exposure, the job can ask for any other tile size
+#define SINGLE_IMG_WIDTH_UM     160
+#define SINGLE_IMG_HEIGHT_UM    180
+
+struct tile_geometry;
+struct remap_lut;
+
+// Mirrors one scaled row into the frame and rotates it by the optics shift
+typedef void (*flip_shift_fn)(uint8_t *dst, const uint8_t *src, const struct tile_geometry *g);
+
+/*
+ * Sizes of the job image (1 px per um), of one exposure and of the projector
+ * frame. tile_geometry_init() checks them and picks the row kernel once per
+ * job: specialised for the 640 px frame in mono and RGB, generic otherwise.
+ */
+struct tile_geometry {
+    int img_w, img_h;
+    int tile_w, tile_h;
+    int out_w, out_h;
+    int shift;
+    int channels;
+
+    flip_shift_fn flip_shift;
+    const char *kernel;
+
+    // Calibrated optics instead of flip_shift when set
+    const struct remap_lut *remap;
+};
+
+int tile_geometry_init(struct tile_geometry *g, int img_w, int img_h, int tile_w, int tile_h,
+                       int overlap, int channels);
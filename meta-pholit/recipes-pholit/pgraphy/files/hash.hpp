@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * XXH64, for telling frames, tiles and jobs apart. Not cryptographic, but
+ * fast enough to run over every uploaded frame.
+ */
+
+#define HASH_P1     0x9E3779B185EBCA87ull
+#define HASH_P2     0xC2B2AE3D27D4EB4Full
+#define HASH_P3     0x165667B19E3779F9ull
+#define HASH_P4     0x85EBCA77C2B2AE63ull
+#define HASH_P5     0x27D4EB2F165667C5ull
+
+    static inline uint64_t
+hash_rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+    static inline uint64_t
+hash_read64(const uint8_t *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+    static inline uint32_t
+hash_read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+    static inline uint64_t
+hash_round(uint64_t acc, uint64_t in)
+{
+    acc += in * HASH_P2;
+    acc = hash_rotl(acc, 31);
+
+    return acc * HASH_P1;
+}
+
+    static inline uint64_t
+hash_merge(uint64_t acc, uint64_t v)
+{
+    acc ^= hash_round(0, v);
+
+    return acc * HASH_P1 + HASH_P4;
+}
+
+    static inline uint64_t
+hash64(const void *data, size_t len, uint64_t seed)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + HASH_P1 + HASH_P2;
+        uint64_t v2 = seed + HASH_P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - HASH_P1;
+
+        do {
+            v1 = hash_round(v1, hash_read64(p));
+            v2 = hash_round(v2, hash_read64(p + 8));
+            v3 = hash_round(v3, hash_read64(p + 16));
+            v4 = hash_round(v4, hash_read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = hash_rotl(v1, 1) + hash_rotl(v2, 7) + hash_rotl(v3, 12) + hash_rotl(v4, 18);
+        h = hash_merge(h, v1);
+        h = hash_merge(h, v2);
+        h = hash_merge(h, v3);
+        h = hash_merge(h, v4);
+    } else {
+        h = seed + HASH_P5;
+    }
+
+    h += len;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= hash_round(0, hash_read64(p));
+        h = hash_rotl(h, 27) * HASH_P1 + HASH_P4;
+    }
+
+    if (p + 4 <= end) {
+        h ^= (uint64_t)hash_read32(p) * HASH_P1;
+        h = hash_rotl(h, 23) * HASH_P2 + HASH_P3;
+        p += 4;
+    }
+
+    for (; p < end; p++) {
+        h ^= *p * HASH_P5;
+        h = hash_rotl(h, 11) * HASH_P1;
+    }
+
+    h ^= h >> 33;
+    h *= HASH_P2;
+    h ^= h >> 29;
+    h *= HASH_P3;
+    h ^= h >> 32;
+
+    return h;
+}
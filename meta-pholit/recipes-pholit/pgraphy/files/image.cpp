@@ -1,31 +1,40 @@
 #include <opencv2/opencv.hpp>
 #include <opencv2/core.hpp>
 #include <vector>
+#include <algorithm>
 #include <lcdc_drv.h>
 
-#include <sys/ioctl.h>
 #include <stdio.h>
-#include <unistd.h>
 
 #include "image.hpp"
+#include "sink.hpp"
+#include "kernels.hpp"
+#include "remap.hpp"
 
-extern int fb_fd;
 uint8_t blackout_buff[WIDTH*HEIGHT*3];
+uint32_t frame_size = WIDTH*HEIGHT*3;
 
 cv::Mat
-read_img(const char *fname, const uint8_t brightness)
+read_img(const char *fname, const uint8_t brightness, bool mono)
 {
     cv::Mat src;
-    src = cv::imread(fname, cv::IMREAD_COLOR);
+    src = cv::imread(fname, mono ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
 
     if(src.empty()) {
-        fprintf(stderr, "cv::imread failed\n");
-        exit(-1);
+        fprintf(stderr, "cv::imread %s failed\n", fname);
+        return src;
+    }
+
+    // Full brightness, as with a flat field, leaves the pixels as they are
+    if (brightness != 255) {
+        src.convertTo(src, CV_32F);
+        src *= (float)brightness/(float)255;
+        src.convertTo(src, CV_8U);
     }
 
-    src.convertTo(src, CV_32F);
-    src *= (float)brightness/(float)255; // 20% brighter
-    src.convertTo(src, CV_8U);
+    if (mono) {
+        return src;
+    }
 
     cv::Mat rgb_src(src.size(), src.type());
     int fromTo[] = {0, 2, 1, 0, 2, 1};
@@ -37,15 +46,53 @@ read_img(const char *fname, const uint8_t brightness)
     int
 write_img(uint8_t *data, uint32_t size)
 {
-    int ret = write(fb_fd, data, size);
-    if (ret == -1) {
-        perror("write:");
+    if (sink->write_frame(data, size) != 0) {
+        exit(-1);
+    }
+
+    return 0;
+}
+
+    int
+slot_init(int count)
+{
+    return sink->slot_init(count);
+}
+
+    int
+write_img_slot(int slot, const uint8_t *data, uint32_t size)
+{
+    if (sink->slot_write(slot, data, size) != 0) {
+        exit(-1);
+    }
+
+    return 0;
+}
+
+    int
+copy_img_slot(int dst, int src)
+{
+    if (sink->slot_copy(dst, src) != 0) {
         exit(-1);
     }
 
-    ret = lseek(fb_fd, 0, SEEK_SET);
-    if (ret == -1) {
-        perror("lseek:");
+    return 0;
+}
+
+    int
+show_img_slot(int slot)
+{
+    if (sink->slot_show(slot) != 0) {
+        exit(-1);
+    }
+
+    return 0;
+}
+
+    int
+wait_vsync(void)
+{
+    if (sink->wait_vsync() != 0) {
         exit(-1);
     }
 
@@ -55,36 +102,60 @@ write_img(uint8_t *data, uint32_t size)
     int 
 evm_reset(void)
 {
-    return ioctl(fb_fd, FB_RESET, NULL);
+    return sink->evm_reset();
 }
 
     int 
 evm_off(void)
 {
-    return ioctl(fb_fd, FB_OFF, NULL);
+    return sink->evm_off();
 }
 
     int 
 evm_on(void)
 {
-    return ioctl(fb_fd, FB_ON, NULL);
+    return sink->evm_on();
 }
     int
 curtain_evm_on(void)
 {
-    return ioctl(fb_fd, FB_BLACKOUT, NULL);
+    return sink->curtain(true);
 }
 
     int
 curtain_evm_off(void)
 {
-    return ioctl(fb_fd, FB_RESTORE, NULL);
+    return sink->curtain(false);
+}
+
+    int
+curtain_evm_async(bool on, unsigned int vsyncs)
+{
+    return sink->curtain_async(on, vsyncs);
+}
+
+    int
+curtain_evm_wait(struct lcd_curtain_done *done)
+{
+    return sink->curtain_wait(done);
 }
 
     int
 blackout_screen(void)
 {
-    return write_img(blackout_buff, WIDTH*HEIGHT*3);
+    return write_img(blackout_buff, frame_size);
+}
+
+    int
+fb_set_mono(bool mono)
+{
+    if (sink->set_mono(mono) != 0) {
+        return -1;
+    }
+
+    frame_size = WIDTH*HEIGHT*(mono ? 1 : 3);
+
+    return 0;
 }
 
 cv::Mat
@@ -104,3 +175,88 @@ moveRightToLeft(const cv::Mat& input, int nPixels) {
 
     return output;
 }
+
+// Scale, mirror and optics correction in one cv::remap() pass over the table
+    static cv::Mat
+remap_tile(const struct tile_geometry *g, const cv::Mat& part, const cv::Mat *gain)
+{
+    const struct remap_lut *lut = g->remap;
+    cv::Mat print_part(g->out_h, g->out_w, part.type());
+
+    for (int y = 0; y < g->out_h; y += REMAP_STRIP_ROWS) {
+        int end = std::min(y + REMAP_STRIP_ROWS, g->out_h);
+        cv::Mat strip = print_part.rowRange(y, end);
+
+        // Edge pixels carry on past the tile, a black border would dim the seams
+        cv::remap(part, strip, lut->map1.rowRange(y, end),
+                  lut->map2.empty() ? cv::Mat() : lut->map2.rowRange(y, end),
+                  lut->interp, cv::BORDER_REPLICATE);
+
+        for (int r = y; gain != NULL && r < end; r++) {
+            mul_weight_u8(print_part.ptr(r), print_part.ptr(r), gain->ptr(r),
+                          (size_t)g->out_w*g->channels);
+        }
+    }
+
+    return print_part;
+}
+
+// Scales one part of the image up to the full projector frame, mirrored for the optics
+cv::Mat
+prepare_tile(const struct tile_geometry *g, const cv::Mat& img, const cv::Rect& sub,
+             const cv::Mat *weight, const cv::Mat *gain)
+{
+    // Reused from tile to tile, only reallocated when the image type changes
+    static thread_local cv::Mat feathered;
+    static thread_local cv::Mat scaled;
+    cv::Mat part = img(sub);
+
+    if (weight != NULL) {
+        feathered.create(part.size(), part.type());
+
+        for (int y = 0; y < part.rows; y++) {
+            mul_weight_u8(feathered.ptr(y), part.ptr(y), weight->ptr(y),
+                          (size_t)part.cols*part.channels());
+        }
+        part = feathered;
+    }
+
+    if (g->remap != NULL) {
+        return remap_tile(g, part, gain);
+    }
+
+    cv::resize(part, scaled, cv::Size(g->out_w, g->out_h));
+
+    cv::Mat print_part(scaled.size(), scaled.type());
+
+    // The flat field goes over each row while it is still in cache
+    for (int y = 0; y < scaled.rows; y++) {
+        g->flip_shift(print_part.ptr(y), scaled.ptr(y), g);
+
+        if (gain != NULL) {
+            mul_weight_u8(print_part.ptr(y), print_part.ptr(y), gain->ptr(y),
+                          (size_t)g->out_w*g->channels);
+        }
+    }
+
+    return print_part;
+}
+
+    void
+split_planes(const cv::Mat& tile, int planes, std::vector<cv::Mat>& out)
+{
+    uint8_t *dst[GREY_PLANES_MAX];
+
+    out.resize(planes);
+    for (int k = 0; k < planes; k++) {
+        out[k].create(tile.size(), tile.type());
+    }
+
+    for (int y = 0; y < tile.rows; y++) {
+        for (int k = 0; k < planes; k++) {
+            dst[k] = out[k].ptr(y);
+        }
+
+        bitplane_split_u8(dst, tile.ptr(y), (size_t)tile.cols*tile.channels(), planes);
+    }
+}
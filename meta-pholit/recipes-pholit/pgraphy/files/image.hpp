@@ -1,16 +1,41 @@
 #pragma once
 
 #include <opencv2/opencv.hpp>
+#include <lcdc_drv.h>
+
+#include "geometry.hpp"
 
 #define WIDTH       640
 #define HEIGHT      360
 
-cv::Mat read_img(const char *fname, const uint8_t brightness);
+// Optics offset between the lcdc scanout and the projected image
+#define TILE_SHIFT_PX   35
+
+// Slot 0 is write_img()'s, frames kept for --grey and step and repeat start here
+#define TILE_SLOT       1
+#define GREY_PLANES_MAX 8
+
+extern uint32_t frame_size;
+
+cv::Mat read_img(const char *fname, const uint8_t brightness, bool mono);
 int write_img(uint8_t *data, uint32_t size);
 int blackout_screen(void);
+int fb_set_mono(bool mono);
 cv::Mat moveRightToLeft(const cv::Mat& input, int nPixel);
+// weight, if given, is a feather mask of the sub size and type, gain a frame sized flat field
+cv::Mat prepare_tile(const struct tile_geometry *g, const cv::Mat& img, const cv::Rect& sub,
+                     const cv::Mat *weight = NULL, const cv::Mat *gain = NULL);
+// Bit planes of a prepared tile, MSB first, every pixel 0 or 255
+void split_planes(const cv::Mat& tile, int planes, std::vector<cv::Mat>& out);
+int slot_init(int count);
+int write_img_slot(int slot, const uint8_t *data, uint32_t size);
+int copy_img_slot(int dst, int src);
+int show_img_slot(int slot);
+int wait_vsync(void);
 int evm_reset(void);
 int evm_off(void);
 int evm_on(void);
 int curtain_evm_off(void);
 int curtain_evm_on(void);
+int curtain_evm_async(bool on, unsigned int vsyncs);
+int curtain_evm_wait(struct lcd_curtain_done *done);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "psf.hpp"
+
+enum job_state {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FAILED,
+    JOB_CANCELLED,
+};
+
+struct job {
+    uint32_t id;
+    int prio;
+
+    std::string file;
+    int time;
+    uint8_t brightness;
+    int xstep, ystep;
+    int overlap;
+    int xsize, ysize;       // whole image [um]
+    int tile_w, tile_h;     // one exposure [um]
+    struct psf psf;
+    bool mono;
+    int grey;               // bit planes per tile, 0 for a single binary frame
+    std::string dose;       // dose map, see dose.hpp
+    bool adaptive;          // expose tiles only as long as their peak needs
+    std::string wafer;      // step and repeat wafer map, see wafer.hpp
+
+    // Plan file to execute instead of planning here, in which order otherwise
+    std::string plan;
+    int order;
+
+    // Tile journal, continued instead of started over when resume is set
+    std::string journal;
+    bool resume;
+
+    // Read by daemon clients while the job runs
+    std::atomic<int> state;
+    std::atomic<int> tiles_done;
+    std::atomic<int> tiles_total;
+    std::atomic<bool> cancel;
+};
+
+const char *job_state_name(int state);
+
+// Exposes a whole plate, homing first unless the table position is still trusted
+int run_job(struct job *job);
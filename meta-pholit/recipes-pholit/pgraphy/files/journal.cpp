@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "journal.hpp"
+#include "hash.hpp"
+#include "log.h"
+
+// Checksum over everything before the check field
+    static uint64_t
+journal_check(const struct journal_hdr *hdr)
+{
+    return hash64(hdr, offsetof(struct journal_hdr, check), JOURNAL_MAGIC);
+}
+
+    static uint64_t
+journal_check(const struct journal_tile *rec)
+{
+    return hash64(rec, offsetof(struct journal_tile, check), JOURNAL_MAGIC);
+}
+
+    static uint64_t
+journal_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+    static int
+journal_write_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+
+    while (len) {
+        ssize_t ret = write(fd, p, len);
+
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        p += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
+
+    static void
+journal_syncer(struct journal *j)
+{
+    std::unique_lock<std::mutex> lock(j->lock);
+
+    while (!j->stop) {
+        j->cv.wait_for(lock, std::chrono::milliseconds(JOURNAL_SYNC_MS),
+                       [j] { return j->stop || j->pending >= JOURNAL_SYNC_RECS; });
+
+        if (j->pending == 0) {
+            continue;
+        }
+
+        j->pending = 0;
+
+        lock.unlock();
+        if (fdatasync(j->fd) == -1) {
+            LOG(LOG_ERR, "journal fdatasync failed: %d\n", errno);
+        }
+        lock.lock();
+    }
+}
+
+// Reads back the completed tiles, dropping a torn record at the end if the last run crashed
+    static int
+journal_load(struct journal *j, uint64_t job_hash)
+{
+    struct journal_hdr hdr;
+    struct journal_tile rec;
+    off_t good;
+
+    if (read(j->fd, &hdr, sizeof(hdr)) != sizeof(hdr) || hdr.magic != JOURNAL_MAGIC ||
+        hdr.version != JOURNAL_VERSION || hdr.check != journal_check(&hdr)) {
+        fprintf(stderr, "journal: bad header\n");
+        return -1;
+    }
+
+    if (hdr.job_hash != job_hash || hdr.tiles_total != j->tiles_total) {
+        fprintf(stderr, "journal: belongs to a different job\n");
+        return -1;
+    }
+
+    good = sizeof(hdr);
+
+    while (read(j->fd, &rec, sizeof(rec)) == sizeof(rec)) {
+        if (rec.check != journal_check(&rec) || rec.tile >= j->tiles_total) {
+            break;
+        }
+
+        if (!j->done[rec.tile]) {
+            j->done[rec.tile] = true;
+            j->done_count++;
+        }
+        good += sizeof(rec);
+    }
+
+    if (ftruncate(j->fd, good) == -1 || lseek(j->fd, good, SEEK_SET) == -1) {
+        perror("journal:");
+        return -1;
+    }
+
+    return 0;
+}
+
+    int
+journal_open(struct journal *j, const char *path, uint64_t job_hash,
+             uint32_t tiles_total, bool resume)
+{
+    struct journal_hdr hdr;
+
+    j->tiles_total = tiles_total;
+    j->done.assign(tiles_total, false);
+    j->done_count = 0;
+    j->pending = 0;
+    j->stop = false;
+
+    j->fd = open(path, O_RDWR | O_CREAT | (resume ? 0 : O_TRUNC) | O_CLOEXEC, 0644);
+    if (j->fd == -1) {
+        perror("journal:");
+        return -1;
+    }
+
+    if (resume && lseek(j->fd, 0, SEEK_END) > 0) {
+        lseek(j->fd, 0, SEEK_SET);
+
+        if (journal_load(j, job_hash) != 0) {
+            close(j->fd);
+            return -1;
+        }
+
+        LOG(LOG_INFO, "Resuming, %u/%u tiles already exposed\n", j->done_count, tiles_total);
+    } else {
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.magic = JOURNAL_MAGIC;
+        hdr.version = JOURNAL_VERSION;
+        hdr.job_hash = job_hash;
+        hdr.tiles_total = tiles_total;
+        hdr.created_ns = journal_now_ns();
+        hdr.check = journal_check(&hdr);
+
+        if (ftruncate(j->fd, 0) == -1 || journal_write_all(j->fd, &hdr, sizeof(hdr)) != 0 ||
+            fdatasync(j->fd) == -1) {
+            perror("journal:");
+            close(j->fd);
+            return -1;
+        }
+    }
+
+    j->syncer = std::thread(journal_syncer, j);
+
+    return 0;
+}
+
+    int
+journal_append(struct journal *j, uint32_t tile, int col, int row, int x, int y,
+               uint32_t exposure_ms)
+{
+    struct journal_tile rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.tile = tile;
+    rec.col = col;
+    rec.row = row;
+    rec.x = x;
+    rec.y = y;
+    rec.exposure_ms = exposure_ms;
+    rec.ts_ns = journal_now_ns();
+    rec.check = journal_check(&rec);
+
+    if (journal_write_all(j->fd, &rec, sizeof(rec)) != 0) {
+        LOG(LOG_ERR, "journal write failed: %d\n", errno);
+        return -1;
+    }
+
+    if (tile < j->tiles_total && !j->done[tile]) {
+        j->done[tile] = true;
+        j->done_count++;
+    }
+
+    std::lock_guard<std::mutex> lock(j->lock);
+    if (++j->pending >= JOURNAL_SYNC_RECS) {
+        j->cv.notify_one();
+    }
+
+    return 0;
+}
+
+    void
+journal_close(struct journal *j)
+{
+    {
+        std::lock_guard<std::mutex> lock(j->lock);
+        j->stop = true;
+    }
+    j->cv.notify_one();
+    j->syncer.join();
+
+    fdatasync(j->fd);
+    close(j->fd);
+}
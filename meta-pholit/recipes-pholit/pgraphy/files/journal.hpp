@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Append-only record of exposed tiles, so an interrupted job can continue
+ * from the first unexposed tile. Appending is a single write(); fdatasync()
+ * runs on a background thread, batched every JOURNAL_SYNC_MS or
+ * JOURNAL_SYNC_RECS records.
+ */
+
+#define JOURNAL_MAGIC       0x314a4750  // "PGJ1"
+#define JOURNAL_VERSION     1
+#define JOURNAL_SYNC_MS     500
+#define JOURNAL_SYNC_RECS   16
+
+struct journal_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t job_hash;
+    uint32_t tiles_total;
+    uint32_t reserved;
+    uint64_t created_ns;
+    uint64_t check;
+};
+
+struct journal_tile {
+    uint32_t tile;
+    int16_t col, row;
+    int16_t x, y;
+    uint32_t exposure_ms;
+    uint64_t ts_ns;     // CLOCK_REALTIME
+    uint64_t check;
+};
+
+struct journal {
+    int fd;
+    uint32_t tiles_total;
+    std::vector<bool> done;
+    uint32_t done_count;
+
+    std::mutex lock;
+    std::condition_variable cv;
+    std::thread syncer;
+    uint32_t pending;
+    bool stop;
+};
+
+/*
+ * With resume set an existing journal for the same job_hash is continued,
+ * one for a different job is an error. Without it the journal starts over.
+ */
+int journal_open(struct journal *j, const char *path, uint64_t job_hash,
+                 uint32_t tiles_total, bool resume);
+int journal_append(struct journal *j, uint32_t tile, int col, int row, int x, int y,
+                   uint32_t exposure_ms);
+void journal_close(struct journal *j);
+
+    static inline bool
+journal_tile_done(const struct journal *j, uint32_t tile)
+{
+    return tile < j->done.size() && j->done[tile];
+}
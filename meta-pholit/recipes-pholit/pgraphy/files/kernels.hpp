@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Per pixel loops of the tile preparation. NEON on the target, plain C
+ * everywhere else and for the tails.
+ */
+
+// round(a*b/255), exact for all 8 bit inputs
+    static inline uint8_t
+mul_div255(uint8_t a, uint8_t b)
+{
+    uint32_t t = a*b + 128;
+
+    return (t + (t >> 8)) >> 8;
+}
+
+// dst = src*weight/255, weight being 255 for full dose
+    static inline void
+mul_weight_u8(uint8_t *dst, const uint8_t *src, const uint8_t *weight, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t w = vld1q_u8(weight + i);
+        uint16x8_t lo = vmull_u8(vget_low_u8(s), vget_low_u8(w));
+        uint16x8_t hi = vmull_u8(vget_high_u8(s), vget_high_u8(w));
+
+        // (t + round(t >> 8) + 128) >> 8, the same as mul_div255()
+        vst1q_u8(dst + i, vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                                      vraddhn_u16(hi, vrshrq_n_u16(hi, 8))));
+    }
+#endif
+
+    for (; i < n; i++) {
+        dst[i] = mul_div255(src[i], weight[i]);
+    }
+}
+
+/*
+ * cv::flip() around the vertical axis followed by moving the last shift px
+ * to the front, as one pass: the output row is src[0, shift) reversed then
+ * src[shift, w) reversed. CN and W are compile time when nonzero.
+ */
+    template <int CN, int W>
+    static inline void
+flip_shift_row(uint8_t *dst, const uint8_t *src, int w, int shift, int cn)
+{
+    const int width = W ? W : w;
+    const int ch = CN ? CN : cn;
+
+    for (int x = 0; x < shift; x++) {
+        memcpy(dst + x*ch, src + (shift - 1 - x)*ch, ch);
+    }
+
+    for (int x = shift; x < width; x++) {
+        memcpy(dst + x*ch, src + (width - 1 - x + shift)*ch, ch);
+    }
+}
+
+/*
+ * Requantises a row to planes bits, round(v*(2^planes - 1)/255), and splits
+ * it into bit planes MSB first: dst[k] is 255 where bit planes-1-k is set.
+ */
+    static inline void
+bitplane_split_u8(uint8_t *const *dst, const uint8_t *src, size_t n, int planes)
+{
+    const uint8_t levels = (1 << planes) - 1;
+    size_t i = 0;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint8x8_t l = vdup_n_u8(levels);
+
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint16x8_t lo = vmull_u8(vget_low_u8(s), l);
+        uint16x8_t hi = vmull_u8(vget_high_u8(s), l);
+        uint8x16_t q = vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                                   vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+
+        for (int k = 0; k < planes; k++) {
+            vst1q_u8(dst[k] + i, vtstq_u8(q, vdupq_n_u8(1 << (planes - 1 - k))));
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        uint8_t q = mul_div255(src[i], levels);
+
+        for (int k = 0; k < planes; k++) {
+            dst[k][i] = -((q >> (planes - 1 - k)) & 1);
+        }
+    }
+}
+
+// Whether two n byte rows differ, for uploading only the changed ones
+    static inline bool
+row_differs_u8(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16_t acc = vdupq_n_u8(0);
+
+    for (; i + 16 <= n; i += 16) {
+        acc = vorrq_u8(acc, veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+
+    uint64x2_t d = vreinterpretq_u64_u8(acc);
+    if (vgetq_lane_u64(d, 0) | vgetq_lane_u64(d, 1)) {
+        return true;
+    }
+#endif
+
+    return memcmp(a + i, b + i, n - i) != 0;
+}
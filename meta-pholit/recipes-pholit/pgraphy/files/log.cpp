@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+
+#define LOG_RING_MASK       (LOG_RING_SIZE - 1)
+#define LOG_IDLE_SLEEP_US   5000
+
+/*
+ * Single producer (the owning thread), single consumer (the log thread). A
+ * thread that exits hands its ring back for the next new thread, so there
+ * are only ever as many as threads logging at once.
+ */
+struct log_ring {
+    struct log_rec rec[LOG_RING_SIZE];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> dropped;
+    bool owned;     // under log_rings_lock
+};
+
+int log_level = LOG_INFO;
+
+static const char *log_level_names[] = {
+    "err",
+    "warn",
+    "info",
+    "debug",
+};
+
+static std::mutex log_rings_lock;
+static std::vector<struct log_ring *> log_rings;
+static void log_ring_put(struct log_ring *ring);
+
+struct log_ring_owner {
+    struct log_ring *ring;
+
+    ~log_ring_owner()
+    {
+        if (ring != NULL) {
+            log_ring_put(ring);
+        }
+    }
+};
+
+static thread_local struct log_ring_owner log_local;
+
+static std::thread log_thread;
+static std::atomic<bool> log_running;
+
+    static uint64_t
+log_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+// What the last owner left unread still goes out, behind it in the same ring
+    static struct log_ring *
+log_ring_get(void)
+{
+    std::lock_guard<std::mutex> lock(log_rings_lock);
+
+    for (struct log_ring *ring : log_rings) {
+        if (!ring->owned) {
+            ring->owned = true;
+            return ring;
+        }
+    }
+
+    struct log_ring *ring = new struct log_ring();
+
+    ring->owned = true;
+    log_rings.push_back(ring);
+
+    return ring;
+}
+
+    static void
+log_ring_put(struct log_ring *ring)
+{
+    std::lock_guard<std::mutex> lock(log_rings_lock);
+
+    ring->owned = false;
+}
+
+    struct log_rec *
+log_rec_get(void)
+{
+    struct log_ring *ring = log_local.ring;
+
+    if (ring == NULL) {
+        ring = log_local.ring = log_ring_get();
+    }
+
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+
+    if (head - ring->tail.load(std::memory_order_acquire) == LOG_RING_SIZE) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    struct log_rec *rec = &ring->rec[head & LOG_RING_MASK];
+    rec->ts_ns = log_now_ns();
+
+    return rec;
+}
+
+    void
+log_rec_commit(void)
+{
+    struct log_ring *ring = log_local.ring;
+
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+    static int64_t
+log_arg_sint(const struct log_rec *rec, int n)
+{
+    int shift = 64 - 8 * rec->size[n];
+
+    if (rec->type[n] == LOG_ARG_DOUBLE) {
+        return (int64_t)rec->arg[n].d;
+    }
+
+    return (int64_t)(rec->arg[n].u << shift) >> shift;
+}
+
+    static uint64_t
+log_arg_uint(const struct log_rec *rec, int n)
+{
+    int shift = 64 - 8 * rec->size[n];
+
+    if (rec->type[n] == LOG_ARG_DOUBLE) {
+        return (uint64_t)rec->arg[n].d;
+    }
+
+    return (rec->arg[n].u << shift) >> shift;
+}
+
+// printf conversions are re-applied one argument at a time with the captured type
+    static void
+log_format(FILE *f, const struct log_rec *rec)
+{
+    const char *p = rec->fmt;
+    int n = 0;
+
+    while (*p) {
+        const char *start = p;
+        char spec[32];
+        size_t len = 0;
+
+        while (*p && *p != '%') {
+            p++;
+        }
+        fwrite(start, 1, p - start, f);
+
+        if (*p == '\0') {
+            break;
+        }
+
+        if (p[1] == '%') {
+            fputc('%', f);
+            p += 2;
+            continue;
+        }
+
+        spec[len++] = *p++;
+        while (*p && strchr("-+ #0123456789.", *p) && len < sizeof(spec) - 4) {
+            spec[len++] = *p++;
+        }
+        while (*p && strchr("hlLqjzt", *p)) {
+            p++;
+        }
+
+        char conv = *p;
+        if (conv == '\0' || n >= rec->nargs) {
+            break;
+        }
+        p++;
+
+        switch (conv) {
+            case 'd':
+            case 'i':
+                memcpy(spec + len, "lld", 4);
+                fprintf(f, spec, (long long)log_arg_sint(rec, n));
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                spec[len++] = 'l';
+                spec[len++] = 'l';
+                spec[len++] = conv;
+                spec[len] = '\0';
+                fprintf(f, spec, (unsigned long long)log_arg_uint(rec, n));
+                break;
+            case 'c':
+                memcpy(spec + len, "c", 2);
+                fprintf(f, spec, (int)log_arg_sint(rec, n));
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                spec[len++] = conv;
+                spec[len] = '\0';
+                fprintf(f, spec, rec->type[n] == LOG_ARG_DOUBLE ?
+                        rec->arg[n].d : (double)log_arg_sint(rec, n));
+                break;
+            case 's':
+                memcpy(spec + len, "s", 2);
+                fprintf(f, spec, rec->type[n] == LOG_ARG_STR ?
+                        rec->pool + rec->arg[n].str : "(?)");
+                break;
+            default:
+                memcpy(spec + len, "p", 2);
+                fprintf(f, spec, rec->arg[n].p);
+                break;
+        }
+
+        n++;
+    }
+}
+
+    static void
+log_emit(const struct log_rec *rec)
+{
+    FILE *f = rec->level <= LOG_WARN ? stderr : stdout;
+
+    if (rec->level == LOG_DEBUG) {
+        fprintf(f, "[DEBUG]");
+    }
+
+    log_format(f, rec);
+}
+
+// Rings are never freed, a copy of the list is safe to use without the lock
+    static std::vector<struct log_ring *>
+log_rings_copy(void)
+{
+    std::lock_guard<std::mutex> lock(log_rings_lock);
+
+    return log_rings;
+}
+
+/*
+ * What the threads have committed so far, merged by timestamp so the output
+ * keeps the order things happened in across threads. Stdio runs without
+ * log_rings_lock, a thread logging for the first time never waits on it.
+ */
+    static bool
+log_drain(void)
+{
+    std::vector<struct log_ring *> rings = log_rings_copy();
+    std::vector<uint32_t> tail(rings.size()), head(rings.size());
+    bool any = false;
+
+    for (size_t i = 0; i < rings.size(); i++) {
+        tail[i] = rings[i]->tail.load(std::memory_order_relaxed);
+        head[i] = rings[i]->head.load(std::memory_order_acquire);
+    }
+
+    for (;;) {
+        const struct log_rec *first = NULL;
+        size_t from = 0;
+
+        for (size_t i = 0; i < rings.size(); i++) {
+            const struct log_rec *rec = &rings[i]->rec[tail[i] & LOG_RING_MASK];
+
+            if (tail[i] != head[i] && (first == NULL || rec->ts_ns < first->ts_ns)) {
+                first = rec;
+                from = i;
+            }
+        }
+
+        if (first == NULL) {
+            break;
+        }
+
+        log_emit(first);
+        rings[from]->tail.store(++tail[from], std::memory_order_release);
+        any = true;
+    }
+
+    if (any) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+
+    return any;
+}
+
+    static void
+log_thread_fn(void)
+{
+    while (log_running.load(std::memory_order_relaxed)) {
+        if (!log_drain()) {
+            usleep(LOG_IDLE_SLEEP_US);
+        }
+    }
+
+    log_drain();
+}
+
+    int
+log_start(void)
+{
+    if (log_running.exchange(true)) {
+        return 0;
+    }
+
+    log_thread = std::thread(log_thread_fn);
+
+    // exit() from anywhere still gets the queued records out
+    atexit(log_stop);
+
+    return 0;
+}
+
+    void
+log_stop(void)
+{
+    if (!log_running.exchange(false)) {
+        return;
+    }
+
+    log_thread.join();
+
+    for (struct log_ring *ring : log_rings_copy()) {
+        uint32_t dropped = ring->dropped.load(std::memory_order_relaxed);
+
+        if (dropped) {
+            fprintf(stderr, "log: %u records dropped\n", dropped);
+        }
+    }
+}
+
+    int
+log_level_parse(const char *name)
+{
+    for (int i = LOG_ERR; i <= LOG_DEBUG; i++) {
+        if (strcmp(name, log_level_names[i]) == 0) {
+            return i;
+        }
+    }
+
+    if (name[0] >= '0' && name[0] <= '0' + LOG_DEBUG && name[1] == '\0') {
+        return name[0] - '0';
+    }
+
+    return -1;
+}
@@ -1,13 +1,125 @@
 #pragma once
 
+#include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
-extern bool debug;
+/*
+ * Asynchronous logging. LOG() captures the format pointer and typed arguments
+ * into a fixed-size record on the calling thread's lock-free ring; a
+ * background thread formats and writes them out. A full ring drops the record
+ * instead of blocking the caller.
+ */
+
+enum log_level {
+    LOG_ERR,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG,
+};
+
+#define LOG_MAX_ARGS    10
+#define LOG_STR_POOL    96
+#define LOG_RING_SIZE   1024    // records per thread, power of 2
+
+enum log_arg_type {
+    LOG_ARG_SINT,
+    LOG_ARG_UINT,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STR,
+    LOG_ARG_PTR,
+};
+
+union log_arg {
+    int64_t i;
+    uint64_t u;
+    double d;
+    const void *p;
+    uint16_t str;   // offset into log_rec::pool
+};
+
+struct log_rec {
+    uint64_t ts_ns;
+    const char *fmt;
+    uint8_t level;
+    uint8_t nargs;
+    uint8_t type[LOG_MAX_ARGS];
+    uint8_t size[LOG_MAX_ARGS];
+    union log_arg arg[LOG_MAX_ARGS];
+    uint16_t pool_len;
+    char pool[LOG_STR_POOL];
+};
 
 extern "C" {
-#define dbg_printf(args...) \
-if (debug) { \
-    printf("[DEBUG]"); \
-    printf(args); \
+extern int log_level;
+
+int log_start(void);
+void log_stop(void);
+struct log_rec *log_rec_get(void);
+void log_rec_commit(void);
+int log_level_parse(const char *name);
 }
-};
+
+extern "C++" {
+#include <type_traits>
+
+    template <typename T>
+    static inline void
+log_arg_set(struct log_rec *rec, T v)
+{
+    int n = rec->nargs++;
+
+    rec->size[n] = sizeof(T);
+
+    if constexpr (std::is_floating_point<T>::value) {
+        rec->type[n] = LOG_ARG_DOUBLE;
+        rec->arg[n].d = v;
+    } else if constexpr (std::is_integral<T>::value || std::is_enum<T>::value) {
+        rec->type[n] = std::is_signed<T>::value ? LOG_ARG_SINT : LOG_ARG_UINT;
+        rec->arg[n].i = (int64_t)v;
+    } else if constexpr (std::is_same<typename std::decay<T>::type, char *>::value ||
+                         std::is_same<typename std::decay<T>::type, const char *>::value) {
+        // Strings may not outlive the call, copy what fits
+        const char *s = v ? v : "(null)";
+        size_t len = strnlen(s, LOG_STR_POOL - 1 - rec->pool_len);
+
+        rec->type[n] = LOG_ARG_STR;
+        rec->arg[n].str = rec->pool_len;
+        memcpy(rec->pool + rec->pool_len, s, len);
+        rec->pool[rec->pool_len + len] = '\0';
+        rec->pool_len += len + (rec->pool_len + len + 1 < LOG_STR_POOL);
+    } else {
+        rec->type[n] = LOG_ARG_PTR;
+        rec->arg[n].p = (const void *)v;
+    }
+}
+
+    template <typename... Args>
+    static inline void
+log_write(int level, const char *fmt, Args... args)
+{
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+
+    struct log_rec *rec = log_rec_get();
+
+    if (rec == NULL) {
+        return;
+    }
+
+    rec->level = level;
+    rec->fmt = fmt;
+    rec->nargs = 0;
+    rec->pool_len = 0;
+    (log_arg_set(rec, args), ...);
+
+    log_rec_commit();
+}
+}
+
+// fmt must be a string literal, only its address is recorded
+#define LOG(level, fmt, args...) \
+if ((level) <= log_level) { \
+    log_write(level, fmt, ##args); \
+}
+
+#define dbg_printf(args...) LOG(LOG_DEBUG, args)
@@ -1,4 +1,20 @@
 #include "image.hpp"
+#include "sink.hpp"
+#include "trace.hpp"
+#include "stats.hpp"
+#include "job.hpp"
+#include "daemon.hpp"
+#include "journal.hpp"
+#include "plan.hpp"
+#include "feather.hpp"
+#include "flatfield.hpp"
+#include "remap.hpp"
+#include "cache.hpp"
+#include "psf.hpp"
+#include "dose.hpp"
+#include "wafer.hpp"
+#include "framecache.hpp"
+#include "hash.hpp"
 
 extern "C" {
 #include <stdio.h>
@@ -7,11 +23,14 @@ extern "C" {
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <math.h>
 #include <stdbool.h>
 
 #include <argp.h>
 
+#ifndef PGRAPHY_NATIVE
 #include <gpiod.h>
+#endif
 
 #include "hal/ti_gpio.h"
 #include "hal/ti_i2c.h"
@@ -19,33 +38,72 @@ extern "C" {
 #include "log.h"
 }
 
-#define SLEEP_MS(x) usleep(x*1000)
+// Scaled for runs against table_emu, 1.0 everywhere else
+#define SLEEP_MS(x) usleep((useconds_t)((x)*1000*pgraphy_ctx.args.time_scale))
 
-#define EVM2000_PROJ_ON_TIMEOUT_S 2
+// The steppers are open loop, home again every so often even without a missed ack
+#define TABLE_REHOME_JOBS           10
 
-int fb_fd;
+// ~8 spans per tile, plenty for a few thousand tiles
+#define TRACE_EVENTS_PER_THREAD     (64*1024)
+
+// --grey shows whole frames, a tile's dose may be rounded this far off (percent)
+#define GREY_DOSE_ERR_WARN_PCT      2
+#define GREY_DOSE_ERR_MAX_PCT       10
 
 struct arguments {
     int xsize, ysize;
+    int tile_w, tile_h;
+    struct psf psf;
     int overlap;
     int xstep, ystep;
     int time;
     uint8_t brightness;
+    bool mono;
+    int grey;
+    double time_scale;
 
     char *file;
     char *rpi_path;
+    char *fb_path;
+    char *sink;
+    char *trace_path;
+    char *metrics_path;
+    char *daemon_path;
+    char *journal_path;
+    bool resume;
+    bool plan;
+    char *plan_path;
+    char *from_plan;
+    char *timing_path;
+    char *flat_path;
+    char *optics_path;
+    char *dose_path;
+    bool adaptive;
+    char *wafer_path;
+    int order;
 };
 
 typedef struct pgraphy_ctx_t {
     cv::Mat main_img;
+    bool mono;
+    int jobs_since_homing;
+    struct plan_timing timing;
+    struct feather feather;
+    struct tile_geometry geo;
+    struct flat_field flat;
+    struct optics optics;
+    struct remap_lut remap;
+    struct dose_map dose;
+    struct wafer_map wafer;
+    std::vector<cv::Mat> planes;
+    struct frame_cache frames;
 
     struct arguments args;
 } pgraphy_ctx_t;
 
 pgraphy_ctx_t pgraphy_ctx;
 
-bool debug = false;
-
     error_t
 parse_opt(int key, char *arg, struct argp_state *state)
 {
@@ -68,6 +126,9 @@ parse_opt(int key, char *arg, struct argp_state *state)
             break;
         case 'o':
             arguments->overlap = atoi(arg);
+            if (arguments->overlap < 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
             break;
         case 'w':
             arguments->xstep = atoi(arg);
@@ -84,8 +145,95 @@ parse_opt(int key, char *arg, struct argp_state *state)
         case 'p':
             arguments->rpi_path = arg;
             break;
+        case 'F':
+            arguments->fb_path = arg;
+            break;
+        case 's':
+            arguments->sink = arg;
+            break;
+        case 'T':
+            arguments->trace_path = arg;
+            break;
+        case 'M':
+            arguments->metrics_path = arg;
+            break;
+        case 'D':
+            arguments->daemon_path = arg;
+            break;
+        case 'S':
+            arguments->time_scale = atof(arg);
+            if (arguments->time_scale <= 0.0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
         case 'd':
-            debug = true;
+            log_level = LOG_DEBUG;
+            break;
+        case 'l':
+            val = log_level_parse(arg);
+            if (val < 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            log_level = val;
+            break;
+        case 'm':
+            arguments->mono = true;
+            break;
+        case 'G':
+            arguments->grey = atoi(arg);
+            if (arguments->grey < 1 || arguments->grey > GREY_PLANES_MAX) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
+        case 'j':
+            arguments->journal_path = arg;
+            break;
+        case 'r':
+            arguments->resume = true;
+            break;
+        case 'u':
+            arguments->flat_path = arg;
+            break;
+        case 'A':
+            arguments->optics_path = arg;
+            break;
+        case 'E':
+            arguments->dose_path = arg;
+            break;
+        case 'a':
+            arguments->adaptive = true;
+            break;
+        case 'R':
+            arguments->wafer_path = arg;
+            break;
+        case 'k':
+            cache_dir = arg;
+            break;
+        case 'X':
+            if (psf_parse(&arguments->psf, arg) != 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
+        case 'g':
+            if (sscanf(arg, "%dx%d", &arguments->tile_w, &arguments->tile_h) != 2) {
+                return ARGP_ERR_UNKNOWN;
+            }
+            break;
+        case 'P':
+            arguments->plan = true;
+            arguments->plan_path = arg;
+            break;
+        case 'L':
+            arguments->from_plan = arg;
+            break;
+        case 'C':
+            arguments->timing_path = arg;
+            break;
+        case 'O':
+            arguments->order = plan_order_parse(arg);
+            if (arguments->order < 0) {
+                return ARGP_ERR_UNKNOWN;
+            }
             break;
         default:
             return ARGP_ERR_UNKNOWN;
@@ -97,20 +245,31 @@ parse_opt(int key, char *arg, struct argp_state *state)
     void
 deinit_all(void)
 {
-    curtain_evm_on();
-    close(fb_fd);
+    TRACE_SCOPE("deinit");
+    struct lcd_curtain_done done;
+
+    curtain_evm_async(true, 1);
+    curtain_evm_wait(&done);
+    delete sink;
 }
 
     int
 init_all(void)
 {
-    fb_fd = open("/dev/fb0", O_WRONLY);
+    TRACE_SCOPE("init");
+
+    sink = sink_create(pgraphy_ctx.args.sink, pgraphy_ctx.args.fb_path);
 
-    if (fb_fd == -1) {
-        perror("Open failed:");
+    if (sink == NULL) {
         return -1;
     }
-    dbg_printf("Intitialised fb\n");
+    dbg_printf("Intitialised %s sink\n", pgraphy_ctx.args.sink);
+
+    if (fb_set_mono(pgraphy_ctx.args.mono) != 0) {
+        delete sink;
+        return -1;
+    }
+    pgraphy_ctx.mono = pgraphy_ctx.args.mono;
 
     if (table_init(pgraphy_ctx.args.rpi_path) != 0) {
         printf("table init failed");
@@ -120,62 +279,592 @@ init_all(void)
 
     dbg_printf("Initialised remote table rpi@%s\n", pgraphy_ctx.args.rpi_path);
 
-    curtain_evm_off();
+    // Open the curtain on a frame boundary, the table init is done by now
+    struct lcd_curtain_done done;
+
+    if (curtain_evm_async(false, 1) != 0 || curtain_evm_wait(&done) != 0 || done.on != 0) {
+        fprintf(stderr, "curtain open failed\n");
+        deinit_all();
+        return -1;
+    }
 
     return 0;
 }
 
-#define SINGLE_IMG_WIDTH_UM     160
-#define SINGLE_IMG_HEIGHT_UM    180
+    static void
+job_finish(struct job *job, int state)
+{
+    blackout_screen();
+    job->state = state;
+}
 
-#define UM_TO_PX(x)             (x)
+    static uint64_t
+file_hash(const char *path, uint64_t h)
+{
+    uint8_t buf[64*1024];
+    ssize_t len;
+    int fd;
 
-    void
-__main(void)
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return 0;
+    }
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        h = hash64(buf, len, h);
+    }
+    close(fd);
+
+    return h;
+}
+
+// Image contents plus everything that changes the mask before tiling
+    static uint64_t
+mask_hash(const struct job *job)
 {
-    blackout_screen();
+    int32_t params[] = { job->brightness, job->mono, job->xsize, job->ysize };
+
+    return hash64(params, sizeof(params), file_hash(job->file.c_str(), 0));
+}
+
+// The mask plus everything that changes what ends up on the wafer
+    static uint64_t
+job_hash(const struct job *job, uint64_t mask)
+{
+    int32_t params[] = { job->time, job->xstep, job->ystep, job->overlap, job->tile_w,
+                         job->tile_h, job->grey, job->adaptive };
+    double psf[] = { job->psf.sigma, job->psf.eta };
+    uint64_t h = hash64(psf, sizeof(psf), hash64(params, sizeof(params), mask));
+
+    if (!job->dose.empty()) {
+        h = file_hash(job->dose.c_str(), h);
+    }
+
+    return job->wafer.empty() ? h : file_hash(job->wafer.c_str(), h);
+}
+
+// Frames the LSB plane stays up for to come closest to time
+    static long
+grey_lsb_frames(uint32_t time, int planes)
+{
+    return std::max(1L, lrint(time*1000.0/SINK_FRAME_US/((1 << planes) - 1)));
+}
+
+// What the planes of a tile exposed for time really add up to
+    static uint32_t
+grey_exposure_ms(uint32_t time, int planes)
+{
+    return (uint32_t)lrint(grey_lsb_frames(time, planes)*((1 << planes) - 1)*SINK_FRAME_US/1000.0);
+}
+
+/*
+ * Bit plane k, MSB first, stays up for 2^(planes-1-k) times the LSB, which is
+ * a whole number of frames. Flips are panned right after a vsync so every
+ * plane is scanned out for exactly its frames, whatever the sleep jitter.
+ */
+    static void
+expose_planes(int base, int planes, uint32_t time)
+{
+    long lsb_frames = grey_lsb_frames(time, planes);
+
+    wait_vsync();
+
+    for (int k = 0; k < planes; k++) {
+        show_img_slot(base + k);
+
+        for (long f = 0; f < lsb_frames << (planes - 1 - k); f++) {
+            wait_vsync();
+        }
+    }
+}
+
+// What goes on screen for one tile of the die image, split into its bit planes with --grey
+    static cv::Mat
+tile_frame(const struct job *job, const struct plan_tile& t, uint32_t die_tile,
+           const cv::Mat *gain)
+{
+    cv::Rect sub(t.x, t.y, pgraphy_ctx.geo.tile_w, pgraphy_ctx.geo.tile_h);
+    cv::Mat frame;
 
-    reset_table_pos();
+    frame = prepare_tile(&pgraphy_ctx.geo, pgraphy_ctx.main_img, sub,
+                         feather_mask(&pgraphy_ctx.feather, die_tile), gain);
 
-    cv::resize(pgraphy_ctx.main_img, pgraphy_ctx.main_img, cv::Size(WIDTH, HEIGHT));
+    // Shortened exposure, brighter tile
+    if (t.boost != 1.0f) {
+        frame.convertTo(frame, -1, t.boost);
+    }
 
-    for (int x=WIDTH - SINGLE_IMG_WIDTH_UM; x>=0; x-=SINGLE_IMG_WIDTH_UM) {
-        for (int y=0; y<HEIGHT; y+=SINGLE_IMG_HEIGHT_UM) {
-            cv::Rect sub(x, y, SINGLE_IMG_WIDTH_UM, SINGLE_IMG_HEIGHT_UM);
-            cv::Mat cur_part = pgraphy_ctx.main_img(sub);
-            cv::Mat print_part;
+    if (job->grey) {
+        split_planes(frame, job->grey, pgraphy_ctx.planes);
+    }
 
-            move_table((x/SINGLE_IMG_WIDTH_UM)*pgraphy_ctx.args.xstep, ((HEIGHT - y)/SINGLE_IMG_HEIGHT_UM)*pgraphy_ctx.args.ystep);
+    return frame;
+}
 
-            SLEEP_MS(1000);
+// Into the slots from base on
+    static void
+upload_frame(const struct job *job, const cv::Mat& frame, int base)
+{
+    if (!job->grey) {
+        write_img_slot(base, frame.data, frame.total()*frame.elemSize());
+        return;
+    }
 
-            cv::resize(cur_part, print_part, cv::Size(WIDTH, HEIGHT));
+    for (int k = 0; k < job->grey; k++) {
+        const cv::Mat& plane = pgraphy_ctx.planes[k];
 
-            cv::flip(print_part, print_part, 1);
-            print_part = moveRightToLeft(print_part, 35);
+        write_img_slot(base + k, plane.data, plane.total()*plane.elemSize());
+    }
+}
+
+// Tiles with the same key come out as the same frame
+    static uint64_t
+frame_key(const struct plan_tile& t, uint32_t die_tile)
+{
+    const std::vector<int>& masks = pgraphy_ctx.feather.tile_mask;
+    int32_t mask = die_tile < masks.size() ? masks[die_tile] : -1;
 
-            dbg_printf("Displaying X:[%u/%u], Y:[%u/%u] img part\n" ,
-                       (WIDTH - x)/SINGLE_IMG_WIDTH_UM, WIDTH/SINGLE_IMG_WIDTH_UM,
-                       (y)/SINGLE_IMG_HEIGHT_UM + 1, HEIGHT/SINGLE_IMG_HEIGHT_UM);
-            write_img(print_part.data, 640*360*3);
-            SLEEP_MS(pgraphy_ctx.args.time);
+    return hash64(&t.boost, sizeof(t.boost), hash64(&mask, sizeof(mask), t.src_hash));
+}
+
+/*
+ * As many cache entries as there are distinct frames, within
+ * FRAME_CACHE_BYTES. Returns how many slots ended up in VRAM, which has to
+ * take the staging slots at least on a sink that has any.
+ */
+    static int
+frames_init(const struct job *job, const struct plan *plan)
+{
+    uint32_t die_tiles = plan->tiles_total/plan->dies;
+    int frames = job->grey ? job->grey : 1;
+    std::set<uint64_t> keys;
+    int entries, resident;
+
+    for (const struct plan_tile& t : plan->tiles) {
+        keys.insert(frame_key(t, t.tile % die_tiles));
+    }
+
+    entries = std::min<size_t>(keys.size(), FRAME_CACHE_BYTES/((size_t)frames*frame_size));
+    entries = std::max(entries, 1);
+
+    resident = frame_cache_init(&pgraphy_ctx.frames, entries, frames);
+    if (resident < 0) {
+        return -1;
+    }
+
+    if (resident > 0 && resident < TILE_SLOT + frames) {
+        LOG(LOG_ERR, "%d frames per tile need %d frames of VRAM, there are %d\n",
+            frames, TILE_SLOT + frames, resident);
+        return -1;
+    }
+
+    LOG(LOG_INFO, "%zu distinct frames in %zu tiles, %d cached, %d of %d slots in VRAM\n",
+        keys.size(), plan->tiles.size(), entries, std::max(resident - TILE_SLOT - frames, 0),
+        entries*frames);
+
+    return resident;
+}
+
+    static int
+expose_tiles(struct job *job, const struct plan *plan, struct journal *journal,
+             const cv::Mat *gain)
+{
+    uint32_t die_tiles = plan->tiles_total/plan->dies;
+
+    for (const struct plan_tile& t : plan->tiles) {
+        TRACE_SCOPE_ARG("tile", t.tile);
+        uint32_t die_tile = t.tile % die_tiles;
+        bool hit;
+
+        if (job->cancel) {
+            return JOB_CANCELLED;
+        }
+
+        if (journal != NULL && journal_tile_done(journal, t.tile)) {
+            continue;
+        }
+
+        {
+            TRACE_SCOPE("move");
+            HIST_SCOPE(stat_move);
+
+            if (move_table(t.xpos, t.ypos) != 0) {
+                return JOB_FAILED;
+            }
+        }
+
+        {
+            TRACE_SCOPE("settle");
+            HIST_SCOPE(stat_settle);
+            SLEEP_MS(TILE_SETTLE_MS);
+        }
+
+        // Repeated structures and step and repeat dies find their frame already in a slot
+        int base = frame_cache_get(&pgraphy_ctx.frames, frame_key(t, die_tile), &hit);
+        cv::Mat frame;
+
+        if (!hit) {
+            TRACE_SCOPE("prepare");
+            HIST_SCOPE(stat_prepare);
+            frame = tile_frame(job, t, die_tile, gain);
+        }
+
+        // Everything goes off screen, the exposure then runs on flips alone
+        {
+            TRACE_SCOPE("upload");
+            HIST_SCOPE(stat_upload);
+
+            if (!hit) {
+                upload_frame(job, frame, base);
+            }
+            base = frame_cache_stage(&pgraphy_ctx.frames, base);
+        }
+
+        dbg_printf("Displaying tile %u/%u, col %d row %d\n", t.tile + 1, plan->tiles_total,
+                   t.col, t.row);
+
+        {
+            TRACE_SCOPE("expose");
+            uint64_t start_ns = trace_now_ns();
+            int64_t err_ns;
+
+            if (job->grey) {
+                expose_planes(base, job->grey, t.exposure_ms);
+            } else {
+                show_img_slot(base);
+                SLEEP_MS(t.exposure_ms);
+            }
+
+            err_ns = (int64_t)(trace_now_ns() - start_ns) -
+                     (int64_t)(t.exposure_ms*1e6*pgraphy_ctx.args.time_scale);
+            stat_expose_err.record(err_ns < 0 ? -err_ns : err_ns);
+        }
 
+        {
+            TRACE_SCOPE("blank");
+            HIST_SCOPE(stat_blank);
             blackout_screen();
         }
+
+        job->tiles_done++;
+
+        // Only once the screen is dark, a crash before this exposes the tile again
+        if (journal != NULL &&
+            journal_append(journal, t.tile, t.col, t.row, t.xpos, t.ypos, t.exposure_ms) != 0) {
+            // Going on would leave a journal that has a resume expose tiles twice
+            LOG(LOG_ERR, "Cannot journal tile %u, stopping the job\n", t.tile);
+            return JOB_FAILED;
+        }
+    }
+
+    return JOB_DONE;
+}
+
+// The job image, resized and ready for tiling, with the hash plans and journals are keyed on
+    static int
+job_load(struct job *job, uint64_t *hash)
+{
+    {
+        TRACE_SCOPE("read_img");
+        // With a flat field the brightness rides along with the gain in the tile pass
+        pgraphy_ctx.main_img = read_img(job->file.c_str(),
+                                        pgraphy_ctx.flat.gain.empty() ? job->brightness : 255,
+                                        job->mono);
+    }
+
+    if (pgraphy_ctx.main_img.empty()) {
+        return -1;
+    }
+    dbg_printf("Image read : %s\n", job->file.c_str());
+
+    if (tile_geometry_init(&pgraphy_ctx.geo, job->xsize, job->ysize, job->tile_w, job->tile_h,
+                           job->overlap, pgraphy_ctx.main_img.channels()) != 0) {
+        return -1;
+    }
+
+    if (pgraphy_ctx.args.optics_path != NULL) {
+        TRACE_SCOPE("remap_lut");
+        remap_lut_build(&pgraphy_ctx.remap, &pgraphy_ctx.optics, &pgraphy_ctx.geo);
+        pgraphy_ctx.geo.remap = &pgraphy_ctx.remap;
+    }
+    dbg_printf("Tiles of %dx%d um over %dx%d um, %s kernel\n", job->tile_w, job->tile_h,
+               job->xsize, job->ysize, pgraphy_ctx.geo.remap ? "remap" : pgraphy_ctx.geo.kernel);
+
+    cv::resize(pgraphy_ctx.main_img, pgraphy_ctx.main_img, cv::Size(job->xsize, job->ysize));
+
+    if (job->dose.empty()) {
+        pgraphy_ctx.dose.img.release();
+        pgraphy_ctx.dose.table.clear();
+    } else if (dose_map_load(&pgraphy_ctx.dose, job->dose.c_str(), job->xsize, job->ysize) != 0) {
+        return -1;
+    }
+
+    if (!job->wafer.empty() && wafer_map_load(&pgraphy_ctx.wafer, job->wafer.c_str()) != 0) {
+        return -1;
+    }
+
+    uint64_t mask = mask_hash(job);
+
+    if (job->psf.sigma > 0.0) {
+        TRACE_SCOPE("psf");
+        psf_compensate(pgraphy_ctx.main_img, &job->psf, mask);
     }
+
+    *hash = job_hash(job, mask);
+
+    return 0;
+}
+
+    static int
+job_plan(struct job *job, uint64_t hash, struct plan *plan)
+{
+    TRACE_SCOPE("plan");
+
+    if (!job->plan.empty()) {
+        if (plan_read(plan, job->plan.c_str(), &pgraphy_ctx.geo) != 0) {
+            return -1;
+        }
+
+        if (plan->job_hash != hash) {
+            LOG(LOG_ERR, "Plan %s was made for a different job\n", job->plan.c_str());
+            return -1;
+        }
+    } else {
+        plan_build(plan, &pgraphy_ctx.geo, pgraphy_ctx.main_img, job->xstep, job->ystep, job->overlap, job->order,
+                   job->time, &pgraphy_ctx.dose, job->adaptive);
+
+        if (!job->wafer.empty() &&
+            plan_repeat(plan, &pgraphy_ctx.wafer, &pgraphy_ctx.geo, job->xstep, job->ystep) != 0) {
+            return -1;
+        }
+        plan->job_hash = hash;
+    }
+
+    /*
+     * The LSB plane has to be up for a frame at least, the shortest tile sets
+     * the limit. Tiles then get the frame quantised time they really see, so
+     * the ETA, the journal and the exposure error are about what was shown.
+     */
+    if (job->grey) {
+        uint32_t min_ms = (uint32_t)((((1 << job->grey) - 1)*(uint64_t)SINK_FRAME_US + 999)/1000);
+        double worst = 0.0;
+
+        for (struct plan_tile& t : plan->tiles) {
+            if (t.exposure_ms < min_ms) {
+                LOG(LOG_ERR, "--grey %d needs at least %u ms per tile, a tile gets %u ms\n",
+                    job->grey, min_ms, t.exposure_ms);
+                return -1;
+            }
+
+            uint32_t ms = grey_exposure_ms(t.exposure_ms, job->grey);
+
+            worst = std::max(worst, fabs((double)ms - t.exposure_ms)*100.0/t.exposure_ms);
+            t.exposure_ms = ms;
+        }
+
+        if (worst > GREY_DOSE_ERR_MAX_PCT) {
+            LOG(LOG_ERR, "--grey %d rounds a tile's dose off by %.1f%%, more than %d%%\n",
+                job->grey, worst, GREY_DOSE_ERR_MAX_PCT);
+            return -1;
+        }
+        if (worst > GREY_DOSE_ERR_WARN_PCT) {
+            LOG(LOG_WARN, "--grey %d rounds a tile's dose off by up to %.1f%%\n", job->grey, worst);
+        }
+    }
+
+    plan_estimate(plan, &pgraphy_ctx.timing, true);
+
+    return 0;
+}
+
+// --plan: everything up to the first move, then the schedule instead of the exposure
+    static int
+plan_job(struct job *job)
+{
+    struct plan plan;
+    uint64_t hash;
+
+    if (job_load(job, &hash) != 0) {
+        return -1;
+    }
+
+    // Every order for comparison, the chosen one last so it is what gets written
+    for (int order = 0; order < PLAN_ORDERS; order++) {
+        if (order == job->order) {
+            continue;
+        }
+
+        plan_build(&plan, &pgraphy_ctx.geo, pgraphy_ctx.main_img, job->xstep, job->ystep, job->overlap, order,
+                   job->time, &pgraphy_ctx.dose, job->adaptive);
+
+        if (!job->wafer.empty() &&
+            plan_repeat(&plan, &pgraphy_ctx.wafer, &pgraphy_ctx.geo, job->xstep, job->ystep) != 0) {
+            return -1;
+        }
+        printf("%-12s ETA %8.1f s\n", plan_order_name(order),
+               plan_estimate(&plan, &pgraphy_ctx.timing, true)/1000.0);
+    }
+
+    job->plan = "";
+    if (job_plan(job, hash, &plan) != 0) {
+        return -1;
+    }
+    printf("%-12s ETA %8.1f s\n\n", plan_order_name(plan.order), plan.eta_ms/1000.0);
+
+    plan_print(stdout, &plan);
+
+    if (pgraphy_ctx.args.plan_path != NULL) {
+        return plan_write(&plan, pgraphy_ctx.args.plan_path);
+    }
+
+    return 0;
+}
+
+    static int
+job_expose(struct job *job)
+{
+    TRACE_SCOPE_ARG("job", job->id);
+    struct journal journal;
+    struct plan plan;
+    bool journaling = !job->journal.empty();
+    uint64_t hash;
+    int state;
+
+    job->state = JOB_RUNNING;
+    job->tiles_total = 0;
+    job->tiles_done = 0;
+
+    if (job_load(job, &hash) != 0 || job_plan(job, hash, &plan) != 0) {
+        job->state = JOB_FAILED;
+        return -1;
+    }
+
+    job->tiles_total = plan.tiles.size();
+    feather_build(&pgraphy_ctx.feather, &pgraphy_ctx.geo, plan.overlap);
+    LOG(LOG_INFO, "%d tiles, %d empty skipped, ETA %.1f s\n", (int)plan.tiles.size(),
+        (int)(plan.tiles_total - plan.tiles.size()), plan.eta_ms/1000.0);
+
+    if (journaling) {
+        if (journal_open(&journal, job->journal.c_str(), hash, plan.tiles_total, job->resume) != 0) {
+            job->state = JOB_FAILED;
+            return -1;
+        }
+        job->tiles_done = journal.done_count;
+    }
+
+    if (job->mono != pgraphy_ctx.mono) {
+        if (fb_set_mono(job->mono) != 0) {
+            if (journaling) {
+                journal_close(&journal);
+            }
+            job->state = JOB_FAILED;
+            return -1;
+        }
+        pgraphy_ctx.mono = job->mono;
+    }
+
+    const cv::Mat *gain = NULL;
+    if (!pgraphy_ctx.flat.gain.empty()) {
+        gain = flat_field_get(&pgraphy_ctx.flat, job->brightness, pgraphy_ctx.geo.channels);
+    }
+
+    if (frames_init(job, &plan) < 0) {
+        if (journaling) {
+            journal_close(&journal);
+        }
+        job->state = JOB_FAILED;
+        return -1;
+    }
+
+    blackout_screen();
+
+    // Whatever interrupted the last run may have left the table anywhere
+    if (job->resume) {
+        table_homed = false;
+    }
+
+    if (!table_homed || pgraphy_ctx.jobs_since_homing >= TABLE_REHOME_JOBS) {
+        TRACE_SCOPE("homing");
+
+        if (reset_table_pos() != 0) {
+            if (journaling) {
+                journal_close(&journal);
+            }
+            job_finish(job, JOB_FAILED);
+            return -1;
+        }
+        pgraphy_ctx.jobs_since_homing = 0;
+    } else {
+        dbg_printf("Table position trusted, skipping homing\n");
+    }
+    pgraphy_ctx.jobs_since_homing++;
+
+    state = expose_tiles(job, &plan, journaling ? &journal : NULL, gain);
+    LOG(LOG_INFO, "%u frames prepared, %u reused\n", pgraphy_ctx.frames.misses,
+        pgraphy_ctx.frames.hits);
+
+    if (journaling) {
+        journal_close(&journal);
+    }
+    job_finish(job, state);
+
+    return state == JOB_DONE ? 0 : -1;
+}
+
+// Latencies are reported per job, a daemon keeps the metrics file current
+    int
+run_job(struct job *job)
+{
+    int ret;
+
+    stats_reset();
+
+    ret = job_expose(job);
+
+    stats_report(stdout);
+    fflush(stdout);
+
+    if (pgraphy_ctx.args.metrics_path != NULL) {
+        stats_write_prom(pgraphy_ctx.args.metrics_path);
+    }
+
+    return ret;
 }
 
 struct argp_option options[] = {
     { "xsize", 'x', "XSIZE", 0, "Width of projected image (in um)." },
     { "ysize", 'y', "YSIZE", 0, "Height of projected image (in um)." },
-    { "overlap", 'o', "OVRLP", 0, "Overlap of parts of image (in um)." },
+    { "flat-field", 'u', "FILE", 0, "Measured illumination of the projector field, evened out per pixel" },
+    { "optics", 'A', "FILE", 0, "Calibrated projection optics (mirror, dx, dy, rot, k1, k2, bilinear) instead of the fixed mirror and shift" },
+    { "dose", 'E', "FILE", 0, "Dose map in percent of --time, an image over the whole job or \"col row percent\" lines per tile" },
+    { "repeat", 'R', "FILE", 0, "Step and repeat the image as one die over the wafer map in FILE: pitch_x, pitch_y, cols, rows, skip" },
+    { "adaptive", 'a', 0, 0, "Expose every tile only as long as its brightest pixel needs, brightening the tile to match" },
+    { "psf", 'X', "SIGMA,ETA", 0, "Pre-compensate scattered light spreading ETA of the dose over a gaussian of SIGMA um" },
+    { "cache", 'k', "DIR", 0, "Where derived calibration data is kept [Default " CACHE_DIR_DEFAULT "]" },
+    { "tile", 'g', "WxH", 0, "Size of one exposure (in um) [Default 160x180]" },
+    { "overlap", 'o', "OVRLP", 0, "Overlap of parts of image (in um), feathered at the seams [Default 0]" },
     { "stepx", 'w', "STEP", 0, "Width of one step (in um)." },
     { "stepy", 'h', "STEP", 0, "Height of one step (in um)." },
     { "time", 't', "TIME", 0, "Time of exposure (in ms)." },
     { "file", 'f', "FILE", 0, "Path to file (required)." },
-    { "debug", 'd', 0, 0, "Enable debug mode" },
+    { "debug", 'd', 0, 0, "Enable debug mode, same as --log-level debug" },
+    { "log-level", 'l', "LEVEL", 0, "err, warn, info or debug [Default info]" },
     { "brightness", 'b', "BRIGHTNESS", 0, "Adjust brightness <0;255> [Default 255]" }, 
     { "rpi_path", 'p', "PATH", 0, "Path to RPi pico" },
+    { "fb", 'F', "PATH", 0, "Framebuffer of the projector to use [Default /dev/fb0]" },
+    { "mono", 'm', 0, 0, "Expose in 8bpp monochrome mode, 16 grey levels unless --grey splits the tiles" },
+    { "grey", 'G', "PLANES", 0, "Greyscale dose: split every tile into 1-8 bit planes, each shown for its binary weighted share of --time" },
+    { "time-scale", 'S', "SCALE", 0, "Scale settle and exposure sleeps, for use with table_emu -s [Default 1.0]" },
+    { "trace", 'T', "FILE", 0, "Write a Chrome trace-event timeline of the job to FILE" },
+    { "metrics", 'M', "FILE", 0, "Write latency percentiles to FILE in Prometheus text format" },
+    { "daemon", 'D', "SOCKET", 0, "Stay running and take jobs from a Unix socket at SOCKET" },
+    { "journal", 'j', "FILE", 0, "Record exposed tiles in FILE so an interrupted job can be resumed" },
+    { "resume", 'r', 0, 0, "Continue the job recorded in the --journal FILE, skipping exposed tiles" },
+    { "plan", 'P', "FILE", OPTION_ARG_OPTIONAL, "Dry run: print the tile schedule and ETA without touching hardware, write the plan to FILE" },
+    { "order", 'O', "ORDER", 0, "Tile order: raster or serpentine [Default raster]" },
+    { "from-plan", 'L', "FILE", 0, "Expose the tiles of a plan written by --plan" },
+    { "timing", 'C', "FILE", 0, "Timing model for the ETA, \"name ms\" lines: step, move, settle, upload, blank, home" },
+    { "sink", 's', "SINK", 0, "Frame sink: fb, null, mem[:LOG], raw:DIR or png:DIR [Default fb]" },
     { 0 }
 };
 
@@ -192,16 +881,59 @@ main(int argc, char **argv)
     // TODO: read those default values from config file
     pgraphy_ctx.args.xsize = 640;
     pgraphy_ctx.args.ysize = 360;
+    pgraphy_ctx.args.tile_w = SINGLE_IMG_WIDTH_UM;
+    pgraphy_ctx.args.tile_h = SINGLE_IMG_HEIGHT_UM;
+    pgraphy_ctx.args.psf.sigma = 0.0;
+    pgraphy_ctx.args.psf.eta = 0.0;
     pgraphy_ctx.args.overlap = 0;
     pgraphy_ctx.args.xstep = 50;
     pgraphy_ctx.args.ystep = 50;
     pgraphy_ctx.args.time = 1000;
     pgraphy_ctx.args.brightness = 255;
+    pgraphy_ctx.args.mono = false;
+    pgraphy_ctx.args.grey = 0;
+    pgraphy_ctx.args.time_scale = 1.0;
     pgraphy_ctx.args.file = NULL;
+    pgraphy_ctx.args.fb_path = (char *)"/dev/fb0";
+    pgraphy_ctx.args.sink = (char *)"fb";
+    pgraphy_ctx.args.trace_path = NULL;
+    pgraphy_ctx.args.metrics_path = NULL;
+    pgraphy_ctx.args.daemon_path = NULL;
+    pgraphy_ctx.args.journal_path = NULL;
+    pgraphy_ctx.args.resume = false;
+    pgraphy_ctx.args.plan = false;
+    pgraphy_ctx.args.plan_path = NULL;
+    pgraphy_ctx.args.from_plan = NULL;
+    pgraphy_ctx.args.timing_path = NULL;
+    pgraphy_ctx.args.flat_path = NULL;
+    pgraphy_ctx.args.optics_path = NULL;
+    pgraphy_ctx.args.dose_path = NULL;
+    pgraphy_ctx.args.adaptive = false;
+    pgraphy_ctx.args.wafer_path = NULL;
+    pgraphy_ctx.args.order = PLAN_RASTER;
 
     argp_parse(&argp, argc, argv, 0, 0, &(pgraphy_ctx.args));
 
-    if (pgraphy_ctx.args.file == NULL) {
+    log_start();
+
+    plan_timing_default(&pgraphy_ctx.timing);
+    if (pgraphy_ctx.args.timing_path != NULL &&
+        plan_timing_load(&pgraphy_ctx.timing, pgraphy_ctx.args.timing_path) != 0) {
+        exit(-1);
+    }
+
+    optics_default(&pgraphy_ctx.optics);
+    if (pgraphy_ctx.args.optics_path != NULL &&
+        optics_load(&pgraphy_ctx.optics, pgraphy_ctx.args.optics_path) != 0) {
+        exit(-1);
+    }
+
+    if (pgraphy_ctx.args.flat_path != NULL &&
+        flat_field_load(&pgraphy_ctx.flat, pgraphy_ctx.args.flat_path, WIDTH, HEIGHT) != 0) {
+        exit(-1);
+    }
+
+    if (pgraphy_ctx.args.file == NULL && pgraphy_ctx.args.daemon_path == NULL) {
         fprintf(stderr, "Error: The -f argument is mandatory\n");
         argp_help(&argp, stderr, ARGP_HELP_STD_USAGE, argv[0]);
         exit(-1);
@@ -224,18 +956,66 @@ main(int argc, char **argv)
             pgraphy_ctx.args.rpi_path);
 
 
+    if (pgraphy_ctx.args.trace_path != NULL && trace_init(TRACE_EVENTS_PER_THREAD) != 0) {
+        fprintf(stderr, "trace init failed\n");
+        exit(-1);
+    }
+
+    struct job job;
+    int ret = 0;
+
+    job.id = 0;
+    job.prio = 0;
+    job.file = pgraphy_ctx.args.file ? pgraphy_ctx.args.file : "";
+    job.time = pgraphy_ctx.args.time;
+    job.brightness = pgraphy_ctx.args.brightness;
+    job.xstep = pgraphy_ctx.args.xstep;
+    job.ystep = pgraphy_ctx.args.ystep;
+    job.overlap = pgraphy_ctx.args.overlap;
+    job.xsize = pgraphy_ctx.args.xsize;
+    job.ysize = pgraphy_ctx.args.ysize;
+    job.tile_w = pgraphy_ctx.args.tile_w;
+    job.tile_h = pgraphy_ctx.args.tile_h;
+    job.psf = pgraphy_ctx.args.psf;
+    job.mono = pgraphy_ctx.args.mono;
+    job.grey = pgraphy_ctx.args.grey;
+    job.dose = pgraphy_ctx.args.dose_path ? pgraphy_ctx.args.dose_path : "";
+    job.adaptive = pgraphy_ctx.args.adaptive;
+    job.wafer = pgraphy_ctx.args.wafer_path ? pgraphy_ctx.args.wafer_path : "";
+    job.journal = pgraphy_ctx.args.journal_path ? pgraphy_ctx.args.journal_path : "";
+    job.plan = pgraphy_ctx.args.from_plan ? pgraphy_ctx.args.from_plan : "";
+    job.order = pgraphy_ctx.args.order;
+    job.resume = pgraphy_ctx.args.resume;
+    job.state = JOB_QUEUED;
+    job.tiles_done = 0;
+    job.tiles_total = 0;
+    job.cancel = false;
+
+    if (pgraphy_ctx.args.plan) {
+        ret = plan_job(&job);
+        log_stop();
+
+        return ret == 0 ? 0 : -1;
+    }
     if (init_all() != 0) {
         fprintf(stderr, "init all failed");
         exit(-1);
     }
     dbg_printf("Initialised all succesfully\n");
 
-    pgraphy_ctx.main_img = read_img(pgraphy_ctx.args.file, pgraphy_ctx.args.brightness);
-    dbg_printf("Image read : %s\n", pgraphy_ctx.args.file);
-
-    __main();
+    if (pgraphy_ctx.args.daemon_path != NULL) {
+        ret = daemon_run(pgraphy_ctx.args.daemon_path, &job);
+    } else {
+        ret = run_job(&job);
+    }
 
     deinit_all();
 
-    return 0;
+    if (pgraphy_ctx.args.trace_path != NULL) {
+        trace_dump(pgraphy_ctx.args.trace_path);
+    }
+
+    log_stop();
+
+    return ret == 0 ? 0 : -1;
 }
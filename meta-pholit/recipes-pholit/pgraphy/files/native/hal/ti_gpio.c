@@ -0,0 +1 @@
+#include "hal/ti_gpio.h"
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host stand-in for the TI gpio hal, nothing in pgraphy calls into it yet
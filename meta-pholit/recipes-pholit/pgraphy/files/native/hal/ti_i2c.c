@@ -0,0 +1 @@
+#include "hal/ti_i2c.h"
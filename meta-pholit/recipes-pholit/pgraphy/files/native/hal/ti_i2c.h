@@ -0,0 +1,3 @@
+#pragma once
+
+// Host stand-in for the TI i2c hal, nothing in pgraphy calls into it yet
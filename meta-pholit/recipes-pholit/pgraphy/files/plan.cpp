@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "plan.hpp"
+#include "hash.hpp"
+
+static const char *plan_order_names[] = {
+    "raster",
+    "serpentine",
+};
+
+    void
+plan_timing_default(struct plan_timing *t)
+{
+    t->step = 2*PLAN_US_DELAY_PER_STATE/1000.0;
+    t->move = 5;
+    t->settle = TILE_SETTLE_MS;
+    t->upload = 20;
+    t->blank = 17;
+    t->home = (PLAN_HOME_MAX_ITER*(PLAN_HOME_STEP_X + PLAN_HOME_STEP_Y) +
+               4*PLAN_HOME_BACKOFF)*t->step;
+}
+
+// "name ms" per line, e.g. upload and blank as measured by --metrics
+    int
+plan_timing_load(struct plan_timing *t, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char name[32];
+    double val;
+
+    if (f == NULL) {
+        perror("timing:");
+        return -1;
+    }
+
+    while (fscanf(f, "%31s %lf", name, &val) == 2) {
+        if (strcmp(name, "step") == 0) {
+            t->step = val;
+        } else if (strcmp(name, "move") == 0) {
+            t->move = val;
+        } else if (strcmp(name, "settle") == 0) {
+            t->settle = val;
+        } else if (strcmp(name, "upload") == 0) {
+            t->upload = val;
+        } else if (strcmp(name, "blank") == 0) {
+            t->blank = val;
+        } else if (strcmp(name, "home") == 0) {
+            t->home = val;
+        } else {
+            fprintf(stderr, "timing: unknown entry %s\n", name);
+        }
+    }
+
+    fclose(f);
+
+    return 0;
+}
+
+    int
+plan_order_parse(const char *name)
+{
+    for (int i = 0; i < PLAN_ORDERS; i++) {
+        if (strcmp(name, plan_order_names[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+    const char *
+plan_order_name(int order)
+{
+    return plan_order_names[order];
+}
+
+    void
+plan_axis(std::vector<int>& starts, int size, int tile, int overlap)
+{
+    int n = size <= tile ? 1 : (size - overlap + tile - overlap - 1)/(tile - overlap);
+
+    starts.resize(n);
+
+    for (int i = 0; i < n; i++) {
+        starts[i] = n == 1 ? 0 : (i*(size - tile) + (n - 1)/2)/(n - 1);
+    }
+}
+
+    static uint64_t
+plan_tile_hash(const cv::Mat& part)
+{
+    uint64_t h = PLAN_MAGIC;
+
+    for (int y = 0; y < part.rows; y++) {
+        h = hash64(part.ptr(y), part.cols*part.elemSize(), h);
+    }
+
+    return h;
+}
+
+    void
+plan_build(struct plan *p, const struct tile_geometry *g, const cv::Mat& img, int xstep,
+           int ystep, int overlap, int order, int time, const struct dose_map *dose,
+           bool adaptive)
+{
+    std::vector<int> xs, ys;
+    cv::Rect bounds(0, 0, img.cols, img.rows);
+
+    plan_axis(xs, g->img_w, g->tile_w, overlap);
+    plan_axis(ys, g->img_h, g->tile_h, overlap);
+
+    int cols = xs.size();
+    int rows = ys.size();
+
+    p->tiles_total = cols*rows;
+    p->dies = 1;
+    p->order = order;
+    p->overlap = overlap;
+    p->eta_ms = 0;
+    p->tiles.clear();
+
+    for (int c = 0; c < cols; c++) {
+        int col = cols - 1 - c;
+
+        for (int r = 0; r < rows; r++) {
+            int row = order == PLAN_SERPENTINE && c % 2 ? rows - 1 - r : r;
+            struct plan_tile t;
+
+            t.tile = plan_tile_index(col, row, cols, rows);
+            t.col = col;
+            t.row = row;
+            t.x = xs[col];
+            t.y = ys[row];
+            // One xstep/ystep moves the table by a whole tile
+            t.xpos = t.x*xstep/g->tile_w;
+            t.ypos = (g->img_h - t.y)*ystep/g->tile_h;
+            t.start_ms = 0;
+
+            // Nothing to expose, not worth a move and a settle
+            cv::Rect sub = cv::Rect(t.x, t.y, g->tile_w, g->tile_h) & bounds;
+            cv::Mat part = img(sub).reshape(1);
+            int lit = cv::countNonZero(part);
+            double peak;
+
+            if (lit == 0) {
+                continue;
+            }
+            cv::minMaxLoc(part, NULL, &peak);
+
+            double full_ms = time*dose_map_scale(dose, sub, col, row);
+            double ms = adaptive ? full_ms*peak/255.0 : full_ms;
+
+            if (ms < 0.5) {
+                continue;
+            }
+
+            // Rounded up so the boost never pushes the peak past 255
+            t.exposure_ms = adaptive ? (uint32_t)ceil(ms) : (uint32_t)lrint(ms);
+            t.boost = adaptive ? full_ms/t.exposure_ms : 1.0f;
+            t.peak = peak;
+            t.fill = (uint64_t)lit*100/part.total();
+            t.reserved = 0;
+            t.src_hash = plan_tile_hash(img(sub));
+
+            p->tiles.push_back(t);
+        }
+    }
+}
+
+    uint64_t
+plan_estimate(struct plan *p, const struct plan_timing *t, bool homing)
+{
+    double now = homing ? t->home : 0;
+    // Repeated dies are flipped to from VRAM, not uploaded
+    double upload = p->dies > 1 ? 0 : t->upload;
+    int xpos = 0, ypos = 0;
+
+    for (struct plan_tile& tile : p->tiles) {
+        int steps = abs(tile.xpos - xpos) + abs(tile.ypos - ypos);
+
+        tile.start_ms = (uint32_t)now;
+
+        now += t->move + steps*t->step + t->settle + upload + tile.exposure_ms + t->blank;
+        xpos = tile.xpos;
+        ypos = tile.ypos;
+    }
+
+    p->eta_ms = (uint64_t)now;
+
+    return p->eta_ms;
+}
+
+    void
+plan_print(FILE *f, const struct plan *p)
+{
+    uint64_t exposure_ms = 0;
+
+    fprintf(f, "%6s %4s %4s %6s %6s %12s %8s %4s %4s %5s\n", "tile", "col", "row", "xpos",
+            "ypos", "start", "expose", "peak", "fill", "boost");
+
+    for (const struct plan_tile& t : p->tiles) {
+        fprintf(f, "%6u %4d %4d %6d %6d %9u.%02u %8u %4u %3u%% %5.2f\n", t.tile, t.col, t.row,
+                t.xpos, t.ypos, t.start_ms/1000, t.start_ms%1000/10, t.exposure_ms, t.peak,
+                t.fill, t.boost);
+        exposure_ms += t.exposure_ms;
+    }
+
+    fprintf(f, "%zu of %u tiles, %u empty, %u dies, %d px overlap, order %s, %.1f s exposing, "
+            "ETA %llu:%02llu:%02llu\n",
+            p->tiles.size(), p->tiles_total, p->tiles_total - (uint32_t)p->tiles.size(),
+            p->dies, p->overlap, plan_order_name(p->order), exposure_ms/1000.0,
+            (unsigned long long)p->eta_ms/3600000, (unsigned long long)p->eta_ms/60000%60,
+            (unsigned long long)p->eta_ms/1000%60);
+}
+
+    static uint64_t
+plan_check(const struct plan_hdr *hdr, const struct plan_tile *tiles)
+{
+    uint64_t h = hash64(hdr, offsetof(struct plan_hdr, check), PLAN_MAGIC);
+
+    return hash64(tiles, hdr->count*sizeof(*tiles), h);
+}
+
+    int
+plan_write(const struct plan *p, const char *path)
+{
+    struct plan_hdr hdr;
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL) {
+        perror("plan:");
+        return -1;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = PLAN_MAGIC;
+    hdr.version = PLAN_VERSION;
+    hdr.job_hash = p->job_hash;
+    hdr.tiles_total = p->tiles_total;
+    hdr.count = p->tiles.size();
+    hdr.order = p->order;
+    hdr.overlap = p->overlap;
+    hdr.dies = p->dies;
+    hdr.eta_ms = p->eta_ms;
+    hdr.check = plan_check(&hdr, p->tiles.data());
+
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        fwrite(p->tiles.data(), sizeof(struct plan_tile), hdr.count, f) != hdr.count) {
+        perror("plan:");
+        fclose(f);
+        return -1;
+    }
+
+    if (fclose(f) != 0) {
+        perror("plan:");
+        return -1;
+    }
+
+    return 0;
+}
+
+    int
+plan_read(struct plan *p, const char *path, const struct tile_geometry *g)
+{
+    struct plan_hdr hdr;
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        perror("plan:");
+        return -1;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != PLAN_MAGIC ||
+        hdr.version != PLAN_VERSION || hdr.count > hdr.tiles_total ||
+        hdr.order >= PLAN_ORDERS || hdr.dies == 0 || hdr.tiles_total % hdr.dies) {
+        fprintf(stderr, "plan: %s is not a plan\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    p->tiles.resize(hdr.count);
+
+    if (fread(p->tiles.data(), sizeof(struct plan_tile), hdr.count, f) != hdr.count ||
+        hdr.check != plan_check(&hdr, p->tiles.data())) {
+        fprintf(stderr, "plan: %s is corrupted\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    fclose(f);
+
+    for (const struct plan_tile& t : p->tiles) {
+        if (t.tile >= hdr.tiles_total || t.x < 0 || t.y < 0 ||
+            t.x + g->tile_w > g->img_w || t.y + g->tile_h > g->img_h) {
+            fprintf(stderr, "plan: %s has a tile out of the image\n", path);
+            return -1;
+        }
+
+        if (!(t.boost > 0.0f && t.boost <= 255.0f)) {
+            fprintf(stderr, "plan: %s has a tile with a bad boost\n", path);
+            return -1;
+        }
+    }
+
+    p->job_hash = hdr.job_hash;
+    p->tiles_total = hdr.tiles_total;
+    p->dies = hdr.dies;
+    p->order = hdr.order;
+    p->overlap = hdr.overlap;
+    p->eta_ms = hdr.eta_ms;
+
+    return 0;
+}
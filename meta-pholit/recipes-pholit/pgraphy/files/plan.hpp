@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "geometry.hpp"
+#include "dose.hpp"
+
+/*
+ * The order tiles are exposed in, worked out before touching any hardware.
+ * pgraphy --plan prints it with a time estimate, and can write it out for
+ * --from-plan to execute as is.
+ */
+
+#define TILE_SETTLE_MS          1000
+
+// Mirrors table_ctrl/src/stepper.h, the firmware is built separately
+#define PLAN_US_DELAY_PER_STATE 3000
+#define PLAN_HOME_MAX_ITER      20
+#define PLAN_HOME_STEP_X        40
+#define PLAN_HOME_STEP_Y        50
+#define PLAN_HOME_BACKOFF       30
+
+#define PLAN_MAGIC              0x31504750  // "PGP1"
+#define PLAN_VERSION            4
+
+enum plan_order {
+    PLAN_RASTER,        // columns right to left, each one top to bottom
+    PLAN_SERPENTINE,    // same, every other column bottom to top
+    PLAN_ORDERS,
+};
+
+struct plan_tile {
+    uint32_t tile;          // index in the raster grid, as kept by the journal
+    int16_t col, row;
+    int16_t x, y;           // top left corner in the resized image [px]
+    int16_t xpos, ypos;     // table position [steps]
+    uint32_t start_ms;      // estimated, from the start of the job
+    uint32_t exposure_ms;
+    float boost;            // pixel gain making up for an exposure shortened to the peak
+    uint8_t peak;           // brightest pixel of the tile
+    uint8_t fill;           // lit pixels [%]
+    uint16_t reserved;
+    uint64_t src_hash;      // tile contents, equal for repeated structures
+};
+
+struct plan_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t job_hash;
+    uint32_t tiles_total;
+    uint32_t count;
+    uint32_t order;
+    uint32_t overlap;
+    uint32_t dies;
+    uint32_t reserved;
+    uint64_t eta_ms;
+    uint64_t check;         // over the header up to here and all tiles
+};
+
+struct plan {
+    uint64_t job_hash;
+    uint32_t tiles_total;   // whole grid, empty tiles included
+    uint32_t dies;          // step and repeat, tiles_total/dies tiles per die
+    int order;
+    int overlap;
+    uint64_t eta_ms;
+    std::vector<struct plan_tile> tiles;
+};
+
+// Everything in ms, defaults from the firmware constants and measured runs
+struct plan_timing {
+    double step;            // one stepper step, both axes move one after another
+    double move;            // command round trip on top of the steps
+    double settle;
+    double upload;
+    double blank;
+    double home;            // worst case, every probe misses
+};
+
+void plan_timing_default(struct plan_timing *t);
+int plan_timing_load(struct plan_timing *t, const char *path);
+
+int plan_order_parse(const char *name);
+const char *plan_order_name(int order);
+
+/*
+ * Tile start positions along one axis, spread evenly so neighbours share at
+ * least overlap px and the last tile ends flush with the image.
+ */
+void plan_axis(std::vector<int>& starts, int size, int tile, int overlap);
+
+    static inline uint32_t
+plan_tile_index(int col, int row, int cols, int rows)
+{
+    return (cols - 1 - col)*rows + row;
+}
+
+/*
+ * img is the job image already resized to the geometry. Every tile gets
+ * time ms scaled by the dose map, and with adaptive set only as long as its
+ * peak needs, the tile then being brightened to make up for it.
+ */
+void plan_build(struct plan *p, const struct tile_geometry *g, const cv::Mat& img, int xstep,
+                int ystep, int overlap, int order, int time, const struct dose_map *dose,
+                bool adaptive);
+uint64_t plan_estimate(struct plan *p, const struct plan_timing *t, bool homing);
+void plan_print(FILE *f, const struct plan *p);
+
+int plan_write(const struct plan *p, const char *path);
+int plan_read(struct plan *p, const char *path, const struct tile_geometry *g);
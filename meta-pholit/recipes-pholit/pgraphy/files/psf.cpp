@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "psf.hpp"
+#include "cache.hpp"
+#include "hash.hpp"
+#include "log.h"
+
+    int
+psf_parse(struct psf *p, const char *spec)
+{
+    if (sscanf(spec, "%lf,%lf", &p->sigma, &p->eta) != 2 ||
+        p->sigma < 0.0 || p->eta < 0.0 || p->eta >= 1.0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Spectrum of the gaussian centred on (0, 0) and wrapped around, for n x n blocks
+    static cv::Mat
+psf_kernel_spectrum(double sigma, int radius, int n)
+{
+    cv::Mat k = cv::Mat::zeros(n, n, CV_32FC1);
+    cv::Mat spec;
+    double sum = 0;
+
+    for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            sum += exp(-(dx*dx + dy*dy)/(2*sigma*sigma));
+        }
+    }
+
+    for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            k.at<float>((dy + n) % n, (dx + n) % n) =
+                (float)(exp(-(dx*dx + dy*dy)/(2*sigma*sigma))/sum);
+        }
+    }
+
+    cv::dft(k, spec);
+
+    return spec;
+}
+
+/*
+ * Overlap-save: each n x n block is convolved whole, only the middle
+ * step x step part is free of wrap around and gets written out.
+ */
+    static void
+psf_block(const cv::Mat& src, cv::Mat& dst, const cv::Mat& kspec, const struct psf *p,
+          int radius, int n, int ox, int oy)
+{
+    int step = n - 2*radius;
+    int cn = src.channels();
+    cv::Mat in(n, n, CV_32FC1);
+    cv::Mat spec, density;
+    float keep = (float)(1.0 - p->eta);
+
+    for (int c = 0; c < cn; c++) {
+        // Outside the mask is dark
+        for (int y = 0; y < n; y++) {
+            int sy = oy - radius + y;
+            float *row = in.ptr<float>(y);
+
+            for (int x = 0; x < n; x++) {
+                int sx = ox - radius + x;
+
+                row[x] = sy < 0 || sy >= src.rows || sx < 0 || sx >= src.cols ? 0.0f :
+                         src.ptr<uint8_t>(sy)[sx*cn + c];
+            }
+        }
+
+        cv::dft(in, spec);
+        cv::mulSpectrums(spec, kspec, spec, 0);
+        cv::dft(spec, density, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+        for (int y = 0; y < step && oy + y < src.rows; y++) {
+            const float *d = density.ptr<float>(radius + y);
+            const float *s = in.ptr<float>(radius + y);
+            uint8_t *out = dst.ptr<uint8_t>(oy + y);
+
+            for (int x = 0; x < step && ox + x < src.cols; x++) {
+                float b = std::min(std::max(d[radius + x], 0.0f), 255.0f)/255.0f;
+
+                out[(ox + x)*cn + c] = (uint8_t)lrintf(s[radius + x]*keep/(keep + p->eta*b));
+            }
+        }
+    }
+}
+
+    static void
+psf_apply(cv::Mat& img, const struct psf *p)
+{
+    int radius = (int)ceil(3*p->sigma);
+    int n = cv::getOptimalDFTSize(std::max(PSF_BLOCK, 4*radius));
+    int step = n - 2*radius;
+    int bx = (img.cols + step - 1)/step;
+    int by = (img.rows + step - 1)/step;
+    cv::Mat kspec = psf_kernel_spectrum(p->sigma, radius, n);
+    cv::Mat out(img.size(), img.type());
+
+    // Blocks write disjoint parts of out, memory stays at a few n x n buffers per thread
+    cv::parallel_for_(cv::Range(0, bx*by), [&](const cv::Range& r) {
+        for (int i = r.start; i < r.end; i++) {
+            psf_block(img, out, kspec, p, radius, n, (i % bx)*step, (i / bx)*step);
+        }
+    });
+
+    img = out;
+}
+
+    void
+psf_compensate(cv::Mat& img, const struct psf *p, uint64_t img_hash)
+{
+    double params[] = { p->sigma, p->eta };
+    int32_t dims[] = { img.cols, img.rows, img.type() };
+    uint64_t key = hash64(dims, sizeof(dims), hash64(params, sizeof(params), img_hash));
+    size_t len = img.total()*img.elemSize();
+    std::vector<uint8_t> data;
+
+    if (p->sigma <= 0.0 || p->eta <= 0.0) {
+        return;
+    }
+
+    if (cache_read("psf", PSF_MAGIC, key, data) == 0 && data.size() == len) {
+        dbg_printf("PSF compensated mask from %s\n", cache_path("psf", key).c_str());
+        img = cv::Mat(img.size(), img.type(), data.data()).clone();
+        return;
+    }
+
+    psf_apply(img, p);
+
+    data.assign(img.data, img.data + len);
+    cache_write("psf", PSF_MAGIC, key, data);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <opencv2/core.hpp>
+
+/*
+ * First order proximity correction. Scattered light spreads eta of the dose
+ * as a gaussian of sigma um, so isolated features end up with less than
+ * dense ones. Every pixel is scaled by (1 - eta)/((1 - eta) + eta*density),
+ * density being the mask blurred by the same gaussian, which evens the two
+ * out at the dose of an isolated feature.
+ */
+
+#define PSF_MAGIC       0x31534750  // "PGS1"
+
+// Smallest dft block, bigger only for a wide gaussian
+#define PSF_BLOCK       512
+
+struct psf {
+    double sigma;   // [um], 0 for off
+    double eta;     // scattered fraction of the dose, below 1
+};
+
+// "SIGMA,ETA"
+int psf_parse(struct psf *p, const char *spec);
+
+/*
+ * img is the job image at 1 px per um, compensated in place. Results are
+ * cached on disk by img_hash and the psf, so a rerun only reads them back.
+ */
+void psf_compensate(cv::Mat& img, const struct psf *p, uint64_t img_hash);
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "remap.hpp"
+#include "image.hpp"
+#include "cache.hpp"
+#include "hash.hpp"
+#include "log.h"
+
+    void
+optics_default(struct optics *o)
+{
+    o->mirror = true;
+    o->dx = -TILE_SHIFT_PX;
+    o->dy = 0;
+    o->rot = 0;
+    o->k1 = 0;
+    o->k2 = 0;
+    o->bilinear = true;
+}
+
+    int
+optics_load(struct optics *o, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char name[32];
+    double val;
+
+    if (f == NULL) {
+        perror("optics:");
+        return -1;
+    }
+
+    while (fscanf(f, "%31s %lf", name, &val) == 2) {
+        if (strcmp(name, "mirror") == 0) {
+            o->mirror = val != 0;
+        } else if (strcmp(name, "dx") == 0) {
+            o->dx = val;
+        } else if (strcmp(name, "dy") == 0) {
+            o->dy = val;
+        } else if (strcmp(name, "rot") == 0) {
+            o->rot = val;
+        } else if (strcmp(name, "k1") == 0) {
+            o->k1 = val;
+        } else if (strcmp(name, "k2") == 0) {
+            o->k2 = val;
+        } else if (strcmp(name, "bilinear") == 0) {
+            o->bilinear = val != 0;
+        } else {
+            fprintf(stderr, "optics: unknown entry %s\n", name);
+        }
+    }
+
+    fclose(f);
+
+    return 0;
+}
+
+    static uint64_t
+remap_key(const struct optics *o, const struct tile_geometry *g)
+{
+    double model[] = { (double)o->mirror, o->dx, o->dy, o->rot, o->k1, o->k2,
+                       (double)o->bilinear };
+    int32_t sizes[] = { g->tile_w, g->tile_h, g->out_w, g->out_h };
+
+    return hash64(sizes, sizeof(sizes), hash64(model, sizeof(model), REMAP_MAGIC));
+}
+
+    static void
+remap_compute(struct remap_lut *lut, const struct optics *o, const struct tile_geometry *g)
+{
+    cv::Mat mapx(g->out_h, g->out_w, CV_32FC1);
+    cv::Mat mapy(g->out_h, g->out_w, CV_32FC1);
+    double cx = (g->out_w - 1)/2.0;
+    double cy = (g->out_h - 1)/2.0;
+    double r2norm = 1.0/(cx*cx + cy*cy);
+    double c = cos(o->rot*M_PI/180.0);
+    double s = sin(o->rot*M_PI/180.0);
+    double sx = (double)g->tile_w/g->out_w;
+    double sy = (double)g->tile_h/g->out_h;
+
+    for (int v = 0; v < g->out_h; v++) {
+        float *mx = mapx.ptr<float>(v);
+        float *my = mapy.ptr<float>(v);
+
+        for (int u = 0; u < g->out_w; u++) {
+            double x = u - cx;
+            double y = v - cy;
+            double r2 = (x*x + y*y)*r2norm;
+            double k = 1.0 + o->k1*r2 + o->k2*r2*r2;
+            double xr = (c*x - s*y)*k + o->dx + cx;
+            double yr = (s*x + c*y)*k + o->dy + cy;
+
+            if (o->mirror) {
+                xr = g->out_w - 1 - xr;
+            }
+
+            // Frame px to tile px, pixel centres lined up as cv::resize() does
+            mx[u] = (float)((xr + 0.5)*sx - 0.5);
+            my[u] = (float)((yr + 0.5)*sy - 0.5);
+        }
+    }
+
+    lut->interp = o->bilinear ? cv::INTER_LINEAR : cv::INTER_NEAREST;
+    cv::convertMaps(mapx, mapy, lut->map1, lut->map2, CV_16SC2, !o->bilinear);
+}
+
+    static void
+remap_pack(const struct remap_lut *lut, std::vector<uint8_t>& data)
+{
+    size_t n1 = lut->map1.total()*lut->map1.elemSize();
+    size_t n2 = lut->map2.total()*lut->map2.elemSize();
+    int32_t dims[] = { lut->map1.cols, lut->map1.rows, lut->interp, (int32_t)(n2 != 0) };
+
+    data.resize(sizeof(dims) + n1 + n2);
+    memcpy(data.data(), dims, sizeof(dims));
+    memcpy(data.data() + sizeof(dims), lut->map1.data, n1);
+    memcpy(data.data() + sizeof(dims) + n1, lut->map2.data, n2);
+}
+
+    static int
+remap_unpack(struct remap_lut *lut, const std::vector<uint8_t>& data, const struct tile_geometry *g)
+{
+    int32_t dims[4];
+
+    if (data.size() < sizeof(dims)) {
+        return -1;
+    }
+    memcpy(dims, data.data(), sizeof(dims));
+
+    size_t n1 = (size_t)g->out_w*g->out_h*4;
+    size_t n2 = dims[3] ? (size_t)g->out_w*g->out_h*2 : 0;
+
+    if (dims[0] != g->out_w || dims[1] != g->out_h || data.size() != sizeof(dims) + n1 + n2) {
+        return -1;
+    }
+
+    lut->interp = dims[2];
+    lut->map1.create(g->out_h, g->out_w, CV_16SC2);
+    memcpy(lut->map1.data, data.data() + sizeof(dims), n1);
+
+    if (n2) {
+        lut->map2.create(g->out_h, g->out_w, CV_16UC1);
+        memcpy(lut->map2.data, data.data() + sizeof(dims) + n1, n2);
+    } else {
+        lut->map2.release();
+    }
+
+    return 0;
+}
+
+    void
+remap_lut_build(struct remap_lut *lut, const struct optics *o, const struct tile_geometry *g)
+{
+    uint64_t key = remap_key(o, g);
+    std::vector<uint8_t> data;
+
+    if (!lut->map1.empty() && lut->key == key) {
+        return;
+    }
+
+    lut->key = key;
+
+    if (cache_read("remap", REMAP_MAGIC, key, data) == 0 && remap_unpack(lut, data, g) == 0) {
+        dbg_printf("Remap table from %s\n", cache_path("remap", key).c_str());
+        return;
+    }
+
+    remap_compute(lut, o, g);
+
+    remap_pack(lut, data);
+    cache_write("remap", REMAP_MAGIC, key, data);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <opencv2/core.hpp>
+
+#include "geometry.hpp"
+
+/*
+ * Calibrated model of the projection optics, replacing the plain mirror and
+ * the wrapping TILE_SHIFT_PX rotation. For every frame pixel it gives the
+ * point of the tile to show there, scale from tile to frame included, and
+ * is compiled once into a fixed point table for cv::remap().
+ */
+
+#define REMAP_MAGIC         0x31524750  // "PGR1"
+
+// Rows remapped at a time, so the flat field runs on them while in cache
+#define REMAP_STRIP_ROWS    16
+
+struct optics {
+    bool mirror;        // around the vertical axis, as the projector is mounted
+    double dx, dy;      // offset [frame px], sub-pixel
+    double rot;         // [deg], around the frame centre
+    double k1, k2;      // radial, over the half diagonal normalised to 1
+    bool bilinear;      // otherwise nearest
+};
+
+struct remap_lut {
+    uint64_t key;
+    int interp;
+    cv::Mat map1;       // CV_16SC2, integer source position
+    cv::Mat map2;       // CV_16UC1 interpolation table index, empty for nearest
+};
+
+// What the old cv::flip() and 35 px shift did, minus the wrap around
+void optics_default(struct optics *o);
+// "name value" lines: mirror, dx, dy, rot, k1, k2, bilinear
+int optics_load(struct optics *o, const char *path);
+
+// From the disk cache when the same optics and geometry were seen before
+void remap_lut_build(struct remap_lut *lut, const struct optics *o, const struct tile_geometry *g);
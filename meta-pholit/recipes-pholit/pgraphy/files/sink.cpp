@@ -0,0 +1,579 @@
+#include <opencv2/opencv.hpp>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/fb.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "image.hpp"
+#include "sink.hpp"
+#include "trace.hpp"
+#include "hash.hpp"
+#include "kernels.hpp"
+
+display_sink *sink;
+
+    static uint64_t
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+    uint64_t
+sink_hash(const uint8_t *data, uint32_t size)
+{
+    return hash64(data, size, 0);
+}
+
+    int
+display_sink::slot_init(int count)
+{
+    slots.resize(count);
+
+    return 0;
+}
+
+    int
+display_sink::slot_write(int slot, const uint8_t *data, uint32_t size)
+{
+    if (slot < 0 || slot >= (int)slots.size()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    slots[slot].assign(data, data + size);
+
+    return 0;
+}
+
+    int
+display_sink::slot_copy(int dst, int src)
+{
+    if (src < 0 || src >= (int)slots.size()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return slot_write(dst, slots[src].data(), slots[src].size());
+}
+
+    int
+display_sink::slot_show(int slot)
+{
+    if (slot < 0 || slot >= (int)slots.size()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return write_frame(slots[slot].data(), slots[slot].size());
+}
+
+// Nothing to sync to, a frame period keeps the plane timing of the fbdev sink
+    int
+display_sink::wait_vsync(void)
+{
+    usleep(SINK_FRAME_US);
+
+    return 0;
+}
+
+fb_sink::~fb_sink()
+{
+    if (vram != NULL) {
+        munmap(vram, vram_len);
+    }
+    close(fd);
+}
+
+/*
+ * Writes the rows of data that differ from what the slot holds, slot 0
+ * through the fd and the others into the mapped VRAM. Runs of changed rows
+ * go out as one write each.
+ */
+    int
+fb_sink::upload(int slot, const uint8_t *data, uint32_t size)
+{
+    TRACE_SCOPE("fb_upload");
+
+    if ((int)shadow.size() <= slot) {
+        shadow.resize(slot + 1);
+    }
+
+    std::vector<uint8_t>& old = shadow[slot];
+    uint32_t row = size % HEIGHT ? size : size/HEIGHT;
+    uint32_t rows = size/row;
+    bool full = old.size() != size;
+
+    if (full) {
+        old.resize(size);
+    }
+
+    for (uint32_t y = 0; y < rows; ) {
+        if (!full && !row_differs_u8(&old[y*row], data + y*row, row)) {
+            y++;
+            continue;
+        }
+
+        uint32_t first = y, last = y;
+
+        for (y++; y < rows && y - last <= FB_DIRTY_GAP_ROWS; y++) {
+            if (full || row_differs_u8(&old[y*row], data + y*row, row)) {
+                last = y;
+            }
+        }
+
+        const uint8_t *src = data + first*row;
+        size_t off = first*row;
+        size_t len = (last + 1 - first)*row;
+
+        memcpy(&old[off], src, len);
+
+        if (slot > 0) {
+            memcpy(vram + slot*slot_len + off, src, len);
+            continue;
+        }
+
+        while (len) {
+            ssize_t ret = pwrite(fd, src, len, off);
+
+            if (ret == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("pwrite:");
+                // Unknown what made it out, the next frame goes out whole
+                old.clear();
+                return -1;
+            }
+
+            src += ret;
+            off += ret;
+            len -= ret;
+        }
+    }
+
+    return 0;
+}
+
+    int
+fb_sink::write_frame(const uint8_t *data, uint32_t size)
+{
+    TRACE_SCOPE("fb_write");
+
+    if (upload(0, data, size) != 0) {
+        return -1;
+    }
+
+    // Written off screen if a slot is shown, flip back to it
+    return shown != 0 ? pan(0) : 0;
+}
+
+    int
+fb_sink::pan(int slot)
+{
+    TRACE_SCOPE("FBIOPAN_DISPLAY");
+
+    struct fb_var_screeninfo var;
+
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &var) == -1) {
+        perror("FBIOGET_VSCREENINFO:");
+        return -1;
+    }
+
+    var.xoffset = 0;
+    var.yoffset = slot*var.yres;
+
+    if (ioctl(fd, FBIOPAN_DISPLAY, &var) == -1) {
+        perror("FBIOPAN_DISPLAY:");
+        return -1;
+    }
+    shown = slot;
+
+    return 0;
+}
+
+// The lcdc clamps yres_virtual to its VRAM, whatever does not fit stays in memory
+    int
+fb_sink::slot_init(int count)
+{
+    TRACE_SCOPE("fb_slot_init");
+
+    struct fb_var_screeninfo var;
+    struct fb_fix_screeninfo fix;
+
+    display_sink::slot_init(count);
+    resident = 0;
+
+    if (shown != 0 && pan(0) != 0) {
+        return -1;
+    }
+
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &var) == -1) {
+        perror("FBIOGET_VSCREENINFO:");
+        return -1;
+    }
+
+    // Changing it resets the lcdc, only done when the job asks for more
+    if (var.yres_virtual < count*var.yres) {
+        var.yres_virtual = count*var.yres;
+        var.yoffset = 0;
+        var.activate = FB_ACTIVATE_NOW;
+
+        if (ioctl(fd, FBIOPUT_VSCREENINFO, &var) == -1 ||
+            ioctl(fd, FBIOGET_VSCREENINFO, &var) == -1) {
+            perror("FBIOPUT_VSCREENINFO:");
+            return -1;
+        }
+    }
+
+    if (ioctl(fd, FBIOGET_FSCREENINFO, &fix) == -1) {
+        perror("FBIOGET_FSCREENINFO:");
+        return -1;
+    }
+
+    if (vram == NULL) {
+        void *p = mmap(NULL, fix.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (p == MAP_FAILED) {
+            perror("mmap:");
+            return -1;
+        }
+        vram = (uint8_t *)p;
+        vram_len = fix.smem_len;
+    }
+
+    // Slots moved, only slot 0 still holds what it did
+    if (fix.line_length*var.yres != slot_len && shadow.size() > 1) {
+        shadow.resize(1);
+    }
+    slot_len = fix.line_length*var.yres;
+    resident = std::min<int>(count, var.yres_virtual/var.yres);
+
+    return resident;
+}
+
+    int
+fb_sink::slot_write(int slot, const uint8_t *data, uint32_t size)
+{
+    if (slot >= resident) {
+        return display_sink::slot_write(slot, data, size);
+    }
+
+    if (slot < 0 || size > slot_len) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return upload(slot, data, size);
+}
+
+    int
+fb_sink::slot_copy(int dst, int src)
+{
+    if (src >= 0 && src < resident) {
+        return slot_write(dst, vram + src*slot_len, slot_len);
+    }
+
+    return display_sink::slot_copy(dst, src);
+}
+
+    int
+fb_sink::slot_show(int slot)
+{
+    if (slot >= resident) {
+        return display_sink::slot_show(slot);
+    }
+
+    return slot == shown ? 0 : pan(slot);
+}
+
+    int
+fb_sink::wait_vsync(void)
+{
+    uint32_t crtc = 0;
+
+    if (ioctl(fd, FBIO_WAITFORVSYNC, &crtc) == -1) {
+        perror("FBIO_WAITFORVSYNC:");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * 8bpp uses the lcdc palette, which maps intensity onto the projector
+ * channels. Setting the mode restarts the raster, so it is only set when
+ * it changes.
+ */
+    int
+fb_sink::set_mono(bool mono)
+{
+    TRACE_SCOPE("FBIOPUT_VSCREENINFO");
+
+    struct fb_var_screeninfo var;
+
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &var) == -1) {
+        perror("FBIOGET_VSCREENINFO:");
+        return -1;
+    }
+
+    if (var.bits_per_pixel == (mono ? 8u : 24u)) {
+        return 0;
+    }
+
+    var.bits_per_pixel = mono ? 8 : 24;
+    var.activate = FB_ACTIVATE_NOW;
+
+    // Other pixel format, nothing in VRAM can be diffed against any more
+    shadow.clear();
+
+    if (ioctl(fd, FBIOPUT_VSCREENINFO, &var) == -1) {
+        perror("FBIOPUT_VSCREENINFO:");
+        return -1;
+    }
+
+    return 0;
+}
+
+    int
+fb_sink::curtain(bool on)
+{
+    TRACE_SCOPE(on ? "FB_BLACKOUT" : "FB_RESTORE");
+
+    return ioctl(fd, on ? FB_BLACKOUT : FB_RESTORE, NULL);
+}
+
+    int
+fb_sink::curtain_async(bool on, unsigned int vsyncs)
+{
+    TRACE_SCOPE("FB_CURTAIN_ASYNC");
+
+    struct lcd_curtain_req req;
+
+    req.on = on;
+    req.vsync_count = vsyncs;
+
+    return ioctl(fd, FB_CURTAIN_ASYNC, &req);
+}
+
+    int
+fb_sink::curtain_wait(struct lcd_curtain_done *done)
+{
+    TRACE_SCOPE("FB_CURTAIN_WAIT");
+
+    return ioctl(fd, FB_CURTAIN_WAIT, done);
+}
+
+    int
+fb_sink::evm_reset(void)
+{
+    TRACE_SCOPE("FB_RESET");
+
+    return ioctl(fd, FB_RESET, NULL);
+}
+
+    int
+fb_sink::evm_off(void)
+{
+    TRACE_SCOPE("FB_OFF");
+
+    return ioctl(fd, FB_OFF, NULL);
+}
+
+    int
+fb_sink::evm_on(void)
+{
+    TRACE_SCOPE("FB_ON");
+
+    return ioctl(fd, FB_ON, NULL);
+}
+
+mem_sink::mem_sink(const char *log_path)
+    : last_curtain_ns(0), curtain_on(true), mono(false), log(NULL)
+{
+    ev.reserve(1024);
+
+    if (log_path != NULL) {
+        log = fopen(log_path, "w");
+        if (log == NULL) {
+            perror("mem sink log:");
+        }
+    }
+}
+
+mem_sink::~mem_sink()
+{
+    if (log == NULL) {
+        return;
+    }
+
+    fprintf(log, "type,t_ns,size,hash\n");
+    for (const struct sink_event &e : ev) {
+        fprintf(log, "%s,%llu,%u,%016llx\n",
+                e.type == SINK_EV_FRAME ? "frame" :
+                e.type == SINK_EV_CURTAIN_ON ? "curtain_on" : "curtain_off",
+                (unsigned long long)e.t_ns, e.size, (unsigned long long)e.hash);
+    }
+
+    fclose(log);
+}
+
+    void
+mem_sink::record(enum sink_event_type type, uint32_t size, uint64_t hash)
+{
+    struct sink_event e;
+
+    e.type = type;
+    e.t_ns = now_ns();
+    e.size = size;
+    e.hash = hash;
+
+    ev.push_back(e);
+}
+
+    int
+mem_sink::write_frame(const uint8_t *data, uint32_t size)
+{
+    record(SINK_EV_FRAME, size, sink_hash(data, size));
+
+    return 0;
+}
+
+    int
+mem_sink::set_mono(bool mono)
+{
+    this->mono = mono;
+
+    return 0;
+}
+
+    int
+mem_sink::curtain(bool on)
+{
+    curtain_on = on;
+    last_curtain_ns = now_ns();
+    record(on ? SINK_EV_CURTAIN_ON : SINK_EV_CURTAIN_OFF, 0, 0);
+
+    return 0;
+}
+
+    int
+mem_sink::curtain_async(bool on, unsigned int vsyncs)
+{
+    // As FB_CURTAIN_ASYNC, which takes 0 for the next vsync
+    if (vsyncs > LCD_CURTAIN_MAX_VSYNCS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return curtain(on);
+}
+
+    int
+mem_sink::curtain_wait(struct lcd_curtain_done *done)
+{
+    done->on = curtain_on;
+    done->vsync_ns = last_curtain_ns;
+    done->done_ns = last_curtain_ns;
+
+    return 0;
+}
+
+capture_sink::capture_sink(const char *dir, bool png)
+    : mem_sink(NULL), dir(dir), png(png), count(0)
+{
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+        perror("capture dir:");
+    }
+}
+
+    int
+capture_sink::write_frame(const uint8_t *data, uint32_t size)
+{
+    char path[PATH_MAX];
+
+    mem_sink::write_frame(data, size);
+
+    snprintf(path, sizeof(path), "%s/frame_%05u.%s", dir.c_str(), count++,
+             png ? "png" : "raw");
+
+    if (png) {
+        // Channel order is the one sent to the lcdc, not BGR
+        cv::Mat frame(HEIGHT, WIDTH, mono ? CV_8UC1 : CV_8UC3, (void *)data);
+
+        if (!cv::imwrite(path, frame)) {
+            fprintf(stderr, "cv::imwrite %s failed\n", path);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("capture open:");
+        return -1;
+    }
+
+    int ret = write(fd, data, size) == (ssize_t)size ? 0 : -1;
+    if (ret != 0) {
+        perror("capture write:");
+    }
+
+    close(fd);
+
+    return ret;
+}
+
+    display_sink *
+sink_create(const char *spec, const char *fb_path)
+{
+    if (strcmp(spec, "fb") == 0) {
+        // Read/write for mapping the slots
+        int fd = open(fb_path, O_RDWR);
+
+        if (fd == -1) {
+            perror("Open failed:");
+            return NULL;
+        }
+
+        return new fb_sink(fd);
+    }
+
+    if (strcmp(spec, "null") == 0) {
+        return new null_sink();
+    }
+
+    if (strcmp(spec, "mem") == 0) {
+        return new mem_sink(NULL);
+    }
+
+    if (strncmp(spec, "mem:", 4) == 0) {
+        return new mem_sink(spec + 4);
+    }
+
+    if (strncmp(spec, "raw:", 4) == 0) {
+        return new capture_sink(spec + 4, false);
+    }
+
+    if (strncmp(spec, "png:", 4) == 0) {
+        return new capture_sink(spec + 4, true);
+    }
+
+    fprintf(stderr, "Unknown sink %s\n", spec);
+
+    return NULL;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <lcdc_drv.h>
+
+// The DLPC takes its parallel input at 60 Hz
+#define SINK_FRAME_US   16667
+
+/*
+ * Where exposed frames go. The fbdev sink drives the lcdc/DLPC, the other
+ * ones let the exposure pipeline run without the projector attached.
+ */
+class display_sink {
+public:
+    virtual ~display_sink() {}
+
+    virtual int write_frame(const uint8_t *data, uint32_t size) = 0;
+    virtual int set_mono(bool mono) = 0;
+
+    virtual int curtain(bool on) = 0;
+    virtual int curtain_async(bool on, unsigned int vsyncs) = 0;
+    virtual int curtain_wait(struct lcd_curtain_done *done) = 0;
+
+    virtual int evm_reset(void) { return 0; }
+    virtual int evm_off(void) { return 0; }
+    virtual int evm_on(void) { return 0; }
+
+    /*
+     * Frames kept by the sink so showing one again costs no upload, slot 0
+     * being the one write_frame() fills. slot_init() returns how many of
+     * count stay in display memory, the rest are kept here and written out
+     * again by every slot_show().
+     */
+    virtual int slot_init(int count);
+    virtual int slot_write(int slot, const uint8_t *data, uint32_t size);
+    virtual int slot_copy(int dst, int src);
+    virtual int slot_show(int slot);
+
+    // Returns at the start of the next frame, a slot shown before it is up from then
+    virtual int wait_vsync(void);
+
+protected:
+    std::vector<std::vector<uint8_t> > slots;
+};
+
+/*
+ * lcdc framebuffer, e.g. /dev/fb0. A copy of what every slot holds is kept
+ * so only the rows that changed are written, black over black being free.
+ */
+#define FB_DIRTY_GAP_ROWS   8   // clean rows cheaper to rewrite than to split a write over
+
+class fb_sink : public display_sink {
+public:
+    fb_sink(int fd) : fd(fd), vram(NULL), vram_len(0), slot_len(0), resident(0), shown(0) {}
+    ~fb_sink();
+
+    int write_frame(const uint8_t *data, uint32_t size);
+    int set_mono(bool mono);
+
+    int curtain(bool on);
+    int curtain_async(bool on, unsigned int vsyncs);
+    int curtain_wait(struct lcd_curtain_done *done);
+
+    int evm_reset(void);
+    int evm_off(void);
+    int evm_on(void);
+
+    // Slots are stacked in the virtual screen and flipped to by panning
+    int slot_init(int count);
+    int slot_write(int slot, const uint8_t *data, uint32_t size);
+    int slot_copy(int dst, int src);
+    int slot_show(int slot);
+
+    int wait_vsync(void);
+
+private:
+    int pan(int slot);
+    int upload(int slot, const uint8_t *data, uint32_t size);
+
+    int fd;
+    uint8_t *vram;
+    size_t vram_len;
+    uint32_t slot_len;
+    int resident;
+    int shown;
+    std::vector<std::vector<uint8_t> > shadow;
+};
+
+/* Drops everything, for timing the pipeline without any sink cost */
+class null_sink : public display_sink {
+public:
+    int write_frame(const uint8_t *, uint32_t) { return 0; }
+    int set_mono(bool) { return 0; }
+
+    int curtain(bool) { return 0; }
+    int curtain_async(bool, unsigned int) { return 0; }
+    int curtain_wait(struct lcd_curtain_done *done) { memset(done, 0, sizeof(*done)); return 0; }
+};
+
+enum sink_event_type {
+    SINK_EV_FRAME,
+    SINK_EV_CURTAIN_ON,
+    SINK_EV_CURTAIN_OFF,
+};
+
+struct sink_event {
+    enum sink_event_type type;
+    uint64_t t_ns;
+    uint32_t size;
+    uint64_t hash;
+};
+
+/* Records a hash and CLOCK_MONOTONIC timestamp of every frame and curtain change */
+class mem_sink : public display_sink {
+public:
+    mem_sink(const char *log_path);
+    ~mem_sink();
+
+    int write_frame(const uint8_t *data, uint32_t size);
+    int set_mono(bool mono);
+
+    int curtain(bool on);
+    int curtain_async(bool on, unsigned int vsyncs);
+    int curtain_wait(struct lcd_curtain_done *done);
+
+    const std::vector<struct sink_event> &events(void) const { return ev; }
+
+protected:
+    void record(enum sink_event_type type, uint32_t size, uint64_t hash);
+
+    std::vector<struct sink_event> ev;
+    uint64_t last_curtain_ns;
+    bool curtain_on;
+    bool mono;
+
+private:
+    FILE *log;
+};
+
+/* Dumps every frame into dir as frame_NNNNN.raw or .png */
+class capture_sink : public mem_sink {
+public:
+    capture_sink(const char *dir, bool png);
+
+    int write_frame(const uint8_t *data, uint32_t size);
+
+private:
+    std::string dir;
+    bool png;
+    unsigned int count;
+};
+
+uint64_t sink_hash(const uint8_t *data, uint32_t size);
+
+/*
+ * spec is one of:
+ *  fb          - lcdc framebuffer at fb_path
+ *  null        - discards frames
+ *  mem[:LOG]   - in-memory recorder, optionally writing a CSV log on exit
+ *  raw:DIR     - raw frame capture
+ *  png:DIR     - PNG frame capture
+ */
+display_sink *sink_create(const char *spec, const char *fb_path);
+
+extern display_sink *sink;
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "stats.hpp"
+
+histogram stat_move("move", "Table move round trip, command to Done");
+histogram stat_settle("settle", "Settle wait after a move");
+histogram stat_prepare("prepare", "Tile preparation");
+histogram stat_upload("upload", "Frame upload to the display sink");
+histogram stat_expose_err("expose_error", "Measured minus requested exposure time");
+histogram stat_blank("blank", "Blanking after an exposure");
+
+static histogram *const stats_all[] = {
+    &stat_move,
+    &stat_settle,
+    &stat_prepare,
+    &stat_upload,
+    &stat_expose_err,
+    &stat_blank,
+};
+
+#define N_STATS         (sizeof(stats_all)/sizeof(stats_all[0]))
+
+static const double stats_quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+#define N_QUANTILES     (sizeof(stats_quantiles)/sizeof(stats_quantiles[0]))
+
+    static int
+hist_index(uint64_t v)
+{
+    if (v < HIST_SUB) {
+        return v;
+    }
+
+    int e = 63 - __builtin_clzll(v);
+    int mant = (v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1);
+
+    return HIST_SUB + (e - HIST_SUB_BITS) * HIST_SUB + mant;
+}
+
+// Middle of the bucket, the best guess for any value that landed in it
+    static uint64_t
+hist_value(int idx)
+{
+    if (idx < HIST_SUB) {
+        return idx;
+    }
+
+    int k = idx - HIST_SUB;
+    int shift = k / HIST_SUB;
+    uint64_t mant = HIST_SUB + k % HIST_SUB;
+
+    return (mant << shift) + ((1ull << shift) >> 1);
+}
+
+histogram::histogram(const char *name, const char *help)
+    : name(name), help(help), n(0), total(0), lo(UINT64_MAX), hi(0)
+{
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+    void
+histogram::record(uint64_t v)
+{
+    buckets[hist_index(v)].fetch_add(1, std::memory_order_relaxed);
+    n.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(v, std::memory_order_relaxed);
+
+    uint64_t cur = lo.load(std::memory_order_relaxed);
+    while (v < cur && !lo.compare_exchange_weak(cur, v, std::memory_order_relaxed));
+
+    cur = hi.load(std::memory_order_relaxed);
+    while (v > cur && !hi.compare_exchange_weak(cur, v, std::memory_order_relaxed));
+}
+
+    void
+histogram::reset(void)
+{
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    n.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    lo.store(UINT64_MAX, std::memory_order_relaxed);
+    hi.store(0, std::memory_order_relaxed);
+}
+
+    uint64_t
+histogram::percentile(double p) const
+{
+    uint64_t cnt = count();
+    uint64_t rank = (uint64_t)(p * cnt + 0.5);
+    uint64_t seen = 0;
+
+    if (cnt == 0) {
+        return 0;
+    }
+
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+
+        if (seen >= rank) {
+            uint64_t v = hist_value(i);
+
+            return v < min() ? min() : v > max() ? max() : v;
+        }
+    }
+
+    return max();
+}
+
+    void
+stats_reset(void)
+{
+    for (size_t i = 0; i < N_STATS; i++) {
+        stats_all[i]->reset();
+    }
+}
+
+    void
+stats_report(FILE *f)
+{
+    fprintf(f, "%-14s %8s %10s %10s %10s %10s %10s %10s\n",
+            "latency [ms]", "count", "min", "p50", "p90", "p99", "p99.9", "max");
+
+    for (size_t i = 0; i < N_STATS; i++) {
+        histogram *h = stats_all[i];
+
+        if (h->count() == 0) {
+            continue;
+        }
+
+        fprintf(f, "%-14s %8llu %10.3f", h->name, (unsigned long long)h->count(), h->min() / 1e6);
+        for (size_t q = 0; q < N_QUANTILES; q++) {
+            fprintf(f, " %10.3f", h->percentile(stats_quantiles[q]) / 1e6);
+        }
+        fprintf(f, " %10.3f\n", h->max() / 1e6);
+    }
+}
+
+// Prometheus text exposition, for node_exporter's textfile collector
+    int
+stats_write_prom(const char *path)
+{
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+
+    if (f == NULL) {
+        perror("metrics:");
+        return -1;
+    }
+
+    for (size_t i = 0; i < N_STATS; i++) {
+        histogram *h = stats_all[i];
+
+        fprintf(f, "# HELP pgraphy_%s_seconds %s\n", h->name, h->help);
+        fprintf(f, "# TYPE pgraphy_%s_seconds summary\n", h->name);
+
+        for (size_t q = 0; q < N_QUANTILES; q++) {
+            fprintf(f, "pgraphy_%s_seconds{quantile=\"%g\"} %.9f\n", h->name,
+                    stats_quantiles[q], h->percentile(stats_quantiles[q]) / 1e9);
+        }
+
+        fprintf(f, "pgraphy_%s_seconds_sum %.9f\n", h->name, h->sum() / 1e9);
+        fprintf(f, "pgraphy_%s_seconds_count %llu\n", h->name, (unsigned long long)h->count());
+
+        fprintf(f, "# HELP pgraphy_%s_seconds_max Largest observed value\n", h->name);
+        fprintf(f, "# TYPE pgraphy_%s_seconds_max gauge\n", h->name);
+        fprintf(f, "pgraphy_%s_seconds_max %.9f\n", h->name, h->max() / 1e9);
+    }
+
+    if (fclose(f) != 0) {
+        perror("metrics:");
+        return -1;
+    }
+
+    // The collector must never see a half written file
+    if (rename(tmp.c_str(), path) != 0) {
+        perror("metrics:");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+
+#include "trace.hpp"
+
+/*
+ * Log-linear (HDR style) latency histograms in ns. Values below HIST_SUB are
+ * exact, above that every power of two is split into HIST_SUB buckets, so
+ * any recorded value is off by at most 1/HIST_SUB (~3%). Recording is a few
+ * relaxed atomics and safe from any thread.
+ */
+
+#define HIST_SUB_BITS   5
+#define HIST_SUB        (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS    (HIST_SUB + (64 - HIST_SUB_BITS) * HIST_SUB)
+
+class histogram {
+public:
+    histogram(const char *name, const char *help);
+
+    void record(uint64_t v);
+    void reset(void);
+    uint64_t percentile(double p) const;
+
+    uint64_t count(void) const { return n.load(std::memory_order_relaxed); }
+    uint64_t sum(void) const { return total.load(std::memory_order_relaxed); }
+    uint64_t min(void) const { return lo.load(std::memory_order_relaxed); }
+    uint64_t max(void) const { return hi.load(std::memory_order_relaxed); }
+
+    const char *name;
+    const char *help;
+
+private:
+    std::atomic<uint64_t> buckets[HIST_BUCKETS];
+    std::atomic<uint64_t> n;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> lo;
+    std::atomic<uint64_t> hi;
+};
+
+extern histogram stat_move;
+extern histogram stat_settle;
+extern histogram stat_prepare;
+extern histogram stat_upload;
+extern histogram stat_expose_err;
+extern histogram stat_blank;
+
+// Histograms cover one job, cleared before it starts
+void stats_reset(void);
+void stats_report(FILE *f);
+int stats_write_prom(const char *path);
+
+class hist_scope {
+public:
+    hist_scope(histogram& h) : h(h), start_ns(trace_now_ns()) {}
+    ~hist_scope() { h.record(trace_now_ns() - start_ns); }
+
+private:
+    histogram& h;
+    uint64_t start_ns;
+};
+
+#define HIST_SCOPE(h)   hist_scope TRACE_CAT(hist_, __LINE__)(h)
@@ -1,72 +1,173 @@
 #include <time.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
 
 #include "log.h"
 
 #define TABLE_MOVE_TIMEOUT_S 10
+// Worst case homing is 20 probe iterations of the firmware plus the back-off
+#define TABLE_HOME_TIMEOUT_S 30
 
-#define send_cmd(args...) \
-fprintf(table_fd, args); \
-fflush(table_fd); \
-printf("[Printed to table]"); \
-dbg_printf(args); \
+#define TABLE_LINE_MAX 128
 
-FILE* table_fd;
+// Whatever is still unread belongs to an earlier command, a late ack must not pass for this one's
+#define send_cmd(fmt, args...) \
+table_flush_input(); \
+dprintf(table_fd, fmt, ##args); \
+dbg_printf("[Printed to table] " fmt, ##args); \
+
+int table_fd = -1;
+
+// Read but not yet returned by table_read_line(), poll() only sees what is left in the fd
+static char table_buf[TABLE_LINE_MAX];
+static size_t table_buf_len;
+
+// Cleared by any missed ack, the table may have lost steps or still be moving
+bool table_homed;
 
     int
 table_init(const char* rpi_path)
 {
-    table_fd = fopen(rpi_path, "w+");
+    table_fd = open(rpi_path, O_RDWR | O_NOCTTY | O_CLOEXEC);
 
-    if (table_fd == NULL) {
+    if (table_fd == -1) {
         exit(-1);
     }
+    table_buf_len = 0;
+
+    table_homed = false;
 
     return 0;
 }
 
+    static int64_t
+table_ms_left(const struct timespec *deadline)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (deadline->tv_sec - now.tv_sec)*1000 + (deadline->tv_nsec - now.tv_nsec)/1000000;
+}
+
+    static void
+table_flush_input(void)
+{
+    tcflush(table_fd, TCIFLUSH);
+    table_buf_len = 0;
+}
+
+/*
+ * One line with a wall clock deadline, the Pico only answers once it is
+ * done. A partial line stays buffered for the next call.
+ */
+    static int
+table_read_line(char *data, int size, const struct timespec *deadline)
+{
+    for (;;) {
+        char *nl = (char *)memchr(table_buf, '\n', table_buf_len);
+
+        // A full buffer without a newline is passed on as it is
+        if (nl != NULL || table_buf_len == sizeof(table_buf)) {
+            size_t len = nl != NULL ? (size_t)(nl + 1 - table_buf) : table_buf_len;
+            size_t copy = len < (size_t)size - 1 ? len : (size_t)size - 1;
+
+            memcpy(data, table_buf, copy);
+            data[copy] = '\0';
+            table_buf_len -= len;
+            memmove(table_buf, table_buf + len, table_buf_len);
+
+            return 0;
+        }
+
+        struct pollfd pfd;
+        int64_t ms = table_ms_left(deadline);
+        ssize_t ret;
+
+        if (ms <= 0) {
+            return -1;
+        }
+
+        pfd.fd = table_fd;
+        pfd.events = POLLIN;
+
+        if (poll(&pfd, 1, ms) <= 0) {
+            return -1;
+        }
+
+        ret = read(table_fd, table_buf + table_buf_len, sizeof(table_buf) - table_buf_len);
+        if (ret <= 0) {
+            return -1;
+        }
+        table_buf_len += ret;
+    }
+}
+
+    static void
+table_deadline(struct timespec *deadline, int timeout_s)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_s;
+}
+
     int
-move_table(int16_t x, int8_t y)
+move_table(int16_t x, int16_t y)
 {
+    struct timespec deadline;
+    char data[32];
+
     send_cmd("%d %d \r", x, y);
 
-    clock_t deadline = clock() + TABLE_MOVE_TIMEOUT_S*CLOCKS_PER_SEC;
+    table_deadline(&deadline, TABLE_MOVE_TIMEOUT_S);
 
-    char data[32];
-    
-    while (clock() < deadline) {
-        fgets(data, sizeof(char)*32, table_fd);
+    while (table_ms_left(&deadline) > 0) {
+        if (table_read_line(data, sizeof(data), &deadline) != 0) {
+            continue;
+        }
 
         if (strncmp(data, "Done", 4) == 0) {
             return 0;
         }
 
-        fprintf(table_fd, "%d %d\r", x, y);
-        fflush(table_fd);
+        dprintf(table_fd, "%d %d\r", x, y);
     }
 
-    fprintf(stderr, "Failed to receive table movement ack\n");
-    return 0;
+    table_homed = false;
+    LOG(LOG_ERR, "Failed to receive table movement ack\n");
+
+    return -1;
 }
 
     int
 reset_table_pos(void)
 {
+    struct timespec deadline;
+    char data[32];
+
+    table_homed = false;
+
     send_cmd("start\r");
 
-    clock_t deadline = clock() + TABLE_MOVE_TIMEOUT_S*CLOCKS_PER_SEC;
+    table_deadline(&deadline, TABLE_HOME_TIMEOUT_S);
 
-    char data[32];
-    
-    while (clock() < deadline) {
-        fgets(data, sizeof(char)*32, table_fd);
+    while (table_ms_left(&deadline) > 0) {
+        if (table_read_line(data, sizeof(data), &deadline) != 0) {
+            continue;
+        }
 
         if (strncmp(data, "Done", 4) == 0) {
+            table_homed = true;
             return 0;
         }
     }
 
+    LOG(LOG_ERR, "Failed to receive table homing ack\n");
+
     return -1;
 }
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <mutex>
+#include <vector>
+
+#include "trace.hpp"
+
+struct trace_buf {
+    struct trace_event *ev;
+    uint32_t count;
+    uint32_t dropped;
+    pid_t tid;
+};
+
+bool trace_enabled;
+
+static uint32_t trace_capacity;
+static std::mutex trace_bufs_lock;
+static std::vector<struct trace_buf *> trace_bufs;
+static thread_local struct trace_buf *trace_local;
+
+    int
+trace_init(uint32_t events_per_thread)
+{
+    trace_capacity = events_per_thread;
+    trace_enabled = true;
+
+    uint64_t now = trace_now_ns();
+
+    // Allocate the main thread buffer up front rather than on the first span
+    trace_record("trace_init", now, now, TRACE_NO_ARG);
+
+    return trace_local == NULL ? -1 : 0;
+}
+
+    static struct trace_buf *
+trace_buf_get(void)
+{
+    struct trace_buf *buf = (struct trace_buf *)calloc(1, sizeof(*buf));
+
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    buf->ev = (struct trace_event *)calloc(trace_capacity, sizeof(*buf->ev));
+    if (buf->ev == NULL) {
+        free(buf);
+        return NULL;
+    }
+
+    buf->tid = syscall(SYS_gettid);
+
+    std::lock_guard<std::mutex> lock(trace_bufs_lock);
+    trace_bufs.push_back(buf);
+
+    return buf;
+}
+
+    void
+trace_record(const char *name, uint64_t start_ns, uint64_t end_ns, int64_t arg)
+{
+    struct trace_buf *buf = trace_local;
+
+    if (buf == NULL) {
+        buf = trace_local = trace_buf_get();
+        if (buf == NULL) {
+            return;
+        }
+    }
+
+    if (buf->count == trace_capacity) {
+        buf->dropped++;
+        return;
+    }
+
+    struct trace_event *e = &buf->ev[buf->count++];
+
+    e->name = name;
+    e->start_ns = start_ns;
+    e->dur_ns = end_ns - start_ns;
+    e->arg = arg;
+}
+
+    int
+trace_dump(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    pid_t pid = getpid();
+    bool first = true;
+
+    if (f == NULL) {
+        perror("trace:");
+        return -1;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    std::lock_guard<std::mutex> lock(trace_bufs_lock);
+
+    for (struct trace_buf *buf : trace_bufs) {
+        for (uint32_t i = 0; i < buf->count; i++) {
+            struct trace_event *e = &buf->ev[i];
+
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f",
+                    first ? "" : ",\n", e->name, pid, buf->tid,
+                    e->start_ns / 1e3, e->dur_ns / 1e3);
+
+            if (e->arg != TRACE_NO_ARG) {
+                fprintf(f, ",\"args\":{\"n\":%lld}", (long long)e->arg);
+            }
+
+            fprintf(f, "}");
+            first = false;
+        }
+
+        if (buf->dropped) {
+            fprintf(stderr, "trace: thread %d dropped %u events\n", buf->tid, buf->dropped);
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Scoped timeline spans, dumped as Chrome trace-event JSON (chrome://tracing,
+ * ui.perfetto.dev). Each thread records into its own preallocated buffer, so a
+ * span costs two clock_gettime calls and a store; with tracing off it is a
+ * single branch.
+ */
+
+struct trace_event {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    int64_t arg;
+};
+
+#define TRACE_NO_ARG    INT64_MIN
+
+extern bool trace_enabled;
+
+    static inline uint64_t
+trace_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+int trace_init(uint32_t events_per_thread);
+void trace_record(const char *name, uint64_t start_ns, uint64_t end_ns, int64_t arg);
+int trace_dump(const char *path);
+
+class trace_scope {
+public:
+    trace_scope(const char *name, int64_t arg = TRACE_NO_ARG)
+        : name(name), arg(arg), start_ns(trace_enabled ? trace_now_ns() : 0) {}
+
+    ~trace_scope()
+    {
+        if (trace_enabled) {
+            trace_record(name, start_ns, trace_now_ns(), arg);
+        }
+    }
+
+private:
+    const char *name;
+    int64_t arg;
+    uint64_t start_ns;
+};
+
+#define TRACE_CAT_(a, b)            a##b
+#define TRACE_CAT(a, b)             TRACE_CAT_(a, b)
+
+// name must be a string literal or otherwise outlive the trace
+#define TRACE_SCOPE(name)           trace_scope TRACE_CAT(trace_, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, arg)  trace_scope TRACE_CAT(trace_, __LINE__)(name, arg)
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "wafer.hpp"
+
+    int
+wafer_map_load(struct wafer_map *w, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char name[32];
+    int col, row;
+
+    if (f == NULL) {
+        perror("wafer:");
+        return -1;
+    }
+
+    w->pitch_x = w->pitch_y = 0;
+    w->cols = w->rows = 1;
+    w->skip.clear();
+
+    while (fscanf(f, "%31s", name) == 1) {
+        bool ok = false;
+
+        if (strcmp(name, "pitch_x") == 0) {
+            ok = fscanf(f, "%d", &w->pitch_x) == 1;
+        } else if (strcmp(name, "pitch_y") == 0) {
+            ok = fscanf(f, "%d", &w->pitch_y) == 1;
+        } else if (strcmp(name, "cols") == 0) {
+            ok = fscanf(f, "%d", &w->cols) == 1;
+        } else if (strcmp(name, "rows") == 0) {
+            ok = fscanf(f, "%d", &w->rows) == 1;
+        } else if (strcmp(name, "skip") == 0) {
+            ok = fscanf(f, "%d %d", &col, &row) == 2;
+            if (ok) {
+                w->skip.insert(std::make_pair(col, row));
+            }
+        }
+
+        if (!ok) {
+            fprintf(stderr, "wafer: bad entry %s\n", name);
+            fclose(f);
+            return -1;
+        }
+    }
+
+    fclose(f);
+
+    if (w->cols < 1 || w->rows < 1) {
+        fprintf(stderr, "wafer: no dies in %s\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+    int
+plan_repeat(struct plan *p, const struct wafer_map *w, const struct tile_geometry *g,
+            int xstep, int ystep)
+{
+    std::vector<struct plan_tile> die = p->tiles;
+    uint32_t die_tiles = p->tiles_total;
+    // Height of the whole grid, positions count up from its bottom edge like a mosaic's would
+    int wafer_h = (w->rows - 1)*w->pitch_y + g->img_h;
+
+    if ((w->cols > 1 && w->pitch_x < g->img_w) || (w->rows > 1 && w->pitch_y < g->img_h)) {
+        fprintf(stderr, "wafer: pitch %dx%d is smaller than the %dx%d die\n", w->pitch_x,
+                w->pitch_y, g->img_w, g->img_h);
+        return -1;
+    }
+
+    if ((int64_t)((w->cols - 1)*w->pitch_x + g->img_w)*xstep/g->tile_w > INT16_MAX ||
+        (int64_t)wafer_h*ystep/g->tile_h > INT16_MAX) {
+        fprintf(stderr, "wafer: grid is out of the table's reach\n");
+        return -1;
+    }
+
+    p->tiles.clear();
+
+    for (int row = 0; row < w->rows; row++) {
+        for (int c = 0; c < w->cols; c++) {
+            int col = row % 2 ? w->cols - 1 - c : c;
+            int die_x = col*w->pitch_x;
+            int die_y = row*w->pitch_y;
+
+            if (w->skip.count(std::make_pair(col, row))) {
+                continue;
+            }
+
+            for (struct plan_tile t : die) {
+                t.tile += (row*w->cols + col)*die_tiles;
+                t.xpos = (die_x + t.x)*xstep/g->tile_w;
+                t.ypos = (wafer_h - die_y - t.y)*ystep/g->tile_h;
+                p->tiles.push_back(t);
+            }
+        }
+    }
+
+    p->dies = w->cols*w->rows;
+    p->tiles_total = p->dies*die_tiles;
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <set>
+#include <utility>
+
+#include "plan.hpp"
+
+/*
+ * Step and repeat: the job image is one die, exposed over a grid of them.
+ * The map is "name value" lines, all sizes in um like --xsize:
+ *
+ *  pitch_x UM      die to die, at least the die size
+ *  pitch_y UM
+ *  cols N
+ *  rows N
+ *  skip COL ROW    die left out, any number of them
+ *
+ * Die (0, 0) is the top left one, the same way round as the image.
+ */
+
+struct wafer_map {
+    int pitch_x, pitch_y;
+    int cols, rows;
+    std::set<std::pair<int, int> > skip;
+};
+
+int wafer_map_load(struct wafer_map *w, const char *path);
+
+/*
+ * Turns the plan of one die into the whole wafer, dies in serpentine rows.
+ * Tile indices become die*die_tiles + tile so the journal tells the copies
+ * apart, tile%die_tiles is still the tile of the die image.
+ */
+int plan_repeat(struct plan *p, const struct wafer_map *w, const struct tile_geometry *g,
+                int xstep, int ystep);
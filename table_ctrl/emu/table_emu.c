@@ -0,0 +1,350 @@
+// Host side emulator of the table_ctrl firmware.
+//
+// Creates a pseudo-terminal that speaks the protocol of src/main.c and
+// sleeps for as long as the real steppers would take, so pgraphy can be
+// pointed at the pty with -p instead of the Pico.
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <termios.h>
+
+#include "stepper.h"
+
+#define MAX_MSG_LEN         16
+
+// Time of one step as done by step() in stepper.c
+#define US_PER_STEP         (2*US_DELAY_PER_STATE)
+
+typedef struct emu_ctx_t {
+  int master_fd;
+  int slave_fd;
+
+  // Position as reported by get_pos, and where the table physically is
+  int cur_x, cur_y;
+  int phys_x, phys_y;
+
+  double time_scale;
+  double jitter;
+  double drop;
+
+  uint64_t moves;
+  uint64_t dropped;
+  uint64_t busy_us;
+
+  const char *link_path;
+} emu_ctx_t;
+
+emu_ctx_t emu = {
+  .master_fd  = -1,
+  .slave_fd   = -1,
+  .time_scale = 1.0,
+};
+
+volatile sig_atomic_t running = 1;
+
+  static void
+on_signal(int sig)
+{
+  (void)sig;
+  running = 0;
+}
+
+  static double
+rand_unit(void)
+{
+  return (double)rand() / (double)RAND_MAX;
+}
+
+  static int
+iabs(int x)
+{
+  return x < 0 ? 0 - x : x;
+}
+
+// Sleeps for us of emulated firmware time, with jitter and time scaling applied
+  static void
+emu_busy(uint64_t us)
+{
+  double t = (double)us;
+
+  if (emu.jitter > 0.0) {
+    t *= 1.0 + emu.jitter * (2.0 * rand_unit() - 1.0);
+  }
+
+  emu.busy_us += (uint64_t)t;
+
+  t *= emu.time_scale;
+  if (t <= 0.0) {
+    return;
+  }
+
+  struct timespec ts = {
+    .tv_sec   = (time_t)(t / 1e6),
+    .tv_nsec  = (long)((t - (double)((time_t)(t / 1e6)) * 1e6) * 1e3),
+  };
+
+  while (nanosleep(&ts, &ts) == -1 && errno == EINTR && running);
+}
+
+  static void
+ret_msg(const char *msg, ...)
+{
+  char buf[64];
+  va_list args;
+
+  va_start(args, msg);
+  int len = vsnprintf(buf, sizeof(buf), msg, args);
+  va_end(args);
+
+  if (len > 0 && write(emu.master_fd, buf, len) != len) {
+    perror("write");
+  }
+}
+
+// move(): Y first, then X, both axes share step()
+  static uint64_t
+move_us(int x_pos, int y_pos)
+{
+  return (uint64_t)(iabs(y_pos - emu.cur_y) + iabs(x_pos - emu.cur_x)) * US_PER_STEP;
+}
+
+// move_start(): probe towards home until the distance sensor triggers, then back off
+  static uint64_t
+home_us(void)
+{
+  int iter_x = (emu.phys_x + HOME_STEP_X - 1) / HOME_STEP_X;
+  int iter_y = (emu.phys_y + HOME_STEP_Y - 1) / HOME_STEP_Y;
+  int iter = iter_x > iter_y ? iter_x : iter_y;
+
+  if (iter < 1) {
+    iter = 1;
+  }
+
+  if (iter > HOME_MAX_ITER) {
+    iter = HOME_MAX_ITER;
+  }
+
+  return (uint64_t)iter * (HOME_STEP_X + HOME_STEP_Y) * US_PER_STEP +
+    4 * HOME_BACKOFF * US_PER_STEP;
+}
+
+  static bool
+maybe_drop(void)
+{
+  if (emu.drop > 0.0 && rand_unit() < emu.drop) {
+    emu.dropped++;
+    return true;
+  }
+
+  return false;
+}
+
+// Same framing as get_msg() in main.c: up to MAX_MSG_LEN chars or '\r'
+  static int
+get_msg(char *msg)
+{
+  int count = 0;
+  char c;
+
+  do {
+    ssize_t ret = read(emu.master_fd, &c, 1);
+
+    if (ret == -1 && errno == EINTR) {
+      if (!running) {
+        return -1;
+      }
+      continue;
+    }
+
+    if (ret != 1) {
+      return -1;
+    }
+
+    msg[count] = c;
+    count++;
+  } while (count < MAX_MSG_LEN && c != '\r');
+
+  msg[count < MAX_MSG_LEN ? count : MAX_MSG_LEN - 1] = '\0';
+
+  return count;
+}
+
+  static void
+handle_msg(const char *msg)
+{
+  int x, y;
+
+  if (strncmp(msg, "start", 5) == 0) {
+    emu_busy(home_us());
+
+    emu.cur_x = emu.cur_y = 0;
+    emu.phys_x = emu.phys_y = 0;
+
+    if (!maybe_drop()) {
+      ret_msg("Done\n");
+    }
+    return;
+  }
+
+  if (strncmp(msg, "get_pos", 7) == 0) {
+    ret_msg("%d %d", emu.cur_x, emu.cur_y);
+    return;
+  }
+
+  if (sscanf(msg, "%d %d", &x, &y) != 2) {
+    return;
+  }
+
+  if (x > SIZE_X || y > SIZE_Y || x < 0 || y < 0) {
+    return;
+  }
+
+  emu_busy(move_us(x, y));
+
+  emu.phys_x += x - emu.cur_x;
+  emu.phys_y += y - emu.cur_y;
+  emu.cur_x = x;
+  emu.cur_y = y;
+  emu.moves++;
+
+  if (!maybe_drop()) {
+    ret_msg("Done\n");
+  }
+}
+
+  static int
+open_pty(void)
+{
+  struct termios tio;
+
+  emu.master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (emu.master_fd == -1) {
+    perror("posix_openpt");
+    return -1;
+  }
+
+  if (grantpt(emu.master_fd) == -1 || unlockpt(emu.master_fd) == -1) {
+    perror("grantpt");
+    return -1;
+  }
+
+  const char *slave = ptsname(emu.master_fd);
+
+  // Holding the slave open keeps the master readable across pgraphy runs
+  emu.slave_fd = open(slave, O_RDWR | O_NOCTTY);
+  if (emu.slave_fd == -1) {
+    perror("open slave");
+    return -1;
+  }
+
+  // Like the Pico's CDC ACM: no echo, no line editing, no CR/NL translation
+  tcgetattr(emu.slave_fd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(emu.slave_fd, TCSANOW, &tio);
+
+  if (emu.link_path) {
+    unlink(emu.link_path);
+    if (symlink(slave, emu.link_path) == -1) {
+      perror("symlink");
+      return -1;
+    }
+    printf("%s -> %s\n", emu.link_path, slave);
+  } else {
+    printf("%s\n", slave);
+  }
+
+  fflush(stdout);
+
+  return 0;
+}
+
+  static void
+usage(const char *name)
+{
+  fprintf(stderr,
+      "Usage: %s [-l LINK] [-s SCALE] [-j JITTER] [-d DROP] [-x X -y Y] [-r SEED]\n"
+      "  -l LINK    symlink the pty slave to LINK\n"
+      "  -s SCALE   time scale, 1.0 is real time, 0 is instant [1.0]\n"
+      "  -j JITTER  relative move time jitter, e.g. 0.05 for +-5%% [0]\n"
+      "  -d DROP    probability of not answering \"Done\" [0]\n"
+      "  -x X -y Y  physical start position in steps, used for homing [0 0]\n"
+      "  -r SEED    random seed\n",
+      name);
+}
+
+  int
+main(int argc, char **argv)
+{
+  unsigned int seed = (unsigned int)time(NULL);
+  int opt;
+
+  while ((opt = getopt(argc, argv, "l:s:j:d:x:y:r:h")) != -1) {
+    switch (opt) {
+      case 'l':
+        emu.link_path = optarg;
+        break;
+      case 's':
+        emu.time_scale = atof(optarg);
+        break;
+      case 'j':
+        emu.jitter = atof(optarg);
+        break;
+      case 'd':
+        emu.drop = atof(optarg);
+        break;
+      case 'x':
+        emu.phys_x = atoi(optarg);
+        break;
+      case 'y':
+        emu.phys_y = atoi(optarg);
+        break;
+      case 'r':
+        seed = (unsigned int)strtoul(optarg, NULL, 0);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : -1;
+    }
+  }
+
+  srand(seed);
+
+  struct sigaction sa = { .sa_handler = on_signal };
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  if (open_pty() != 0) {
+    return -1;
+  }
+
+  while (running) {
+    char msg[MAX_MSG_LEN];
+
+    if (get_msg(msg) < 0) {
+      break;
+    }
+
+    handle_msg(msg);
+  }
+
+  fprintf(stderr, "moves: %llu, dropped: %llu, emulated busy time: %.3f s\n",
+      (unsigned long long)emu.moves, (unsigned long long)emu.dropped,
+      (double)emu.busy_us / 1e6);
+
+  if (emu.link_path) {
+    unlink(emu.link_path);
+  }
+
+  return 0;
+}
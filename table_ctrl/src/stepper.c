@@ -5,14 +5,7 @@
 #include "pico/stdlib.h"
 #include "dist.h"
 #include "hardware/pwm.h"
-
-#define U_STEPS 16
-#define STATES_PER_ROT 200*U_STEPS
-
-// Delay in ms, please note that changing it may affect distance being traversed by gear
-// It happens due to poor documentation, and minimum time between switchin positions not being specified
-
-#define US_DELAY_PER_STATE  3000
+#include "stepper.h"
 
 #define CLOCKWISE           0
 #define COUNTER_CLOCKWISE   1
@@ -28,9 +21,6 @@
 #define STEP_1_PIN          4
 #define EN_1_PIN            5
 
-#define SIZE_X              700                
-#define SIZE_Y              700                
-
 typedef struct stepper_ctx_t {
   uint8_t step_pin;
   uint8_t dir_pin;
@@ -205,25 +195,25 @@ setup_gpio(void)
   void
 move_start(void)
 {
-  for (int i=0; i<20; i++) {
+  for (int i=0; i<HOME_MAX_ITER; i++) {
     set_en(true, &steppers[1]);
 
-    move_x(-40);
-    maybe_move_y(-50);
+    move_x(-HOME_STEP_X);
+    maybe_move_y(-HOME_STEP_Y);
 
     set_en(false, &steppers[1]);
 
     const uint32_t dist = get_dist();
-    if (dist <= 130) {
+    if (dist <= HOME_DIST_US) {
       break;
     }
   }
 
-  move_x(30);
-  maybe_move_y(30);
+  move_x(HOME_BACKOFF);
+  maybe_move_y(HOME_BACKOFF);
 
-  move_x(-30);
-  maybe_move_y(-30);
+  move_x(-HOME_BACKOFF);
+  maybe_move_y(-HOME_BACKOFF);
 
   cur_x = 0;
   cur_y = 0;
@@ -0,0 +1,22 @@
+#pragma once
+
+// Kept free of pico-sdk includes, emu/table_emu.c models its timing from here
+
+#define U_STEPS 16
+#define STATES_PER_ROT 200*U_STEPS
+
+// Delay in ms, please note that changing it may affect distance being traversed by gear
+// It happens due to poor documentation, and minimum time between switchin positions not being specified
+
+#define US_DELAY_PER_STATE  3000
+
+#define SIZE_X              700                
+#define SIZE_Y              700                
+
+// Homing in move_start(): steps per probe, probes until the distance sensor
+// reads HOME_DIST_US or less, then a back-off and return of HOME_BACKOFF steps
+#define HOME_MAX_ITER       20
+#define HOME_STEP_X         40
+#define HOME_STEP_Y         50
+#define HOME_DIST_US        130
+#define HOME_BACKOFF        30